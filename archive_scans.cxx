@@ -0,0 +1,171 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <arpa/inet.h>
+#include <sqlite3.h>
+#include "scan_archive.h"
+#include "scan_db.h"
+
+const char* ARCHIVE_PATH = "network_scanner.archive";
+
+// Remove blocks left at the end of the archive by an export of this partition that never finished.
+// Blocks for the same days exported earlier (before late results recreated the partition) are kept:
+// their rows all have ids below the partition's lowest id.
+bool discard_partial_export(sqlite3* db, const ScanPartition& partition) {
+    sqlite3_stmt* stmt;
+    std::string sql = "SELECT MIN(id) FROM " + partition.name + ";";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK) {
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    bool empty = sqlite3_step(stmt) != SQLITE_ROW || sqlite3_column_type(stmt, 0) == SQLITE_NULL;
+    int64_t first_id = empty ? 0 : sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    if (empty) return true;
+
+    ScanArchive archive;
+    if (!archive.open(ARCHIVE_PATH)) {
+        std::cerr << "Cannot read archive: " << ARCHIVE_PATH << std::endl;
+        return false;
+    }
+
+    size_t keep = archive.valid_bytes();
+    const std::vector<ArchiveBlock>& blocks = archive.blocks();
+    for (size_t i = blocks.size(); i > 0; --i) {
+        const ArchiveBlockHeader* h = blocks[i - 1].header;
+        if (h->ts_min < partition.start_ts || h->ts_max >= partition.end_ts || h->last_row_id < first_id) break;
+        keep = blocks[i - 1].offset;
+    }
+
+    if (keep == archive.valid_bytes()) return true;
+    archive.close();
+    return truncate_archive(ARCHIVE_PATH, keep);
+}
+
+// Append every row of a partition to the archive; returns the number of rows or -1
+long long export_partition(sqlite3* db, const ScanPartition& partition) {
+    std::string sql = "SELECT id, port, COALESCE(banner, ''), ip_address, ts FROM " + partition.name + " ORDER BY id;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK) {
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        return -1;
+    }
+
+    ArchiveWriter writer;
+    if (!writer.open(ARCHIVE_PATH)) {
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    std::vector<ArchiveRow> rows;
+    rows.reserve(ARCHIVE_BLOCK_ROWS);
+    long long exported = 0;
+    bool ok = true;
+    int rc;
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ArchiveRow row;
+        row.id = sqlite3_column_int64(stmt, 0);
+        row.port = static_cast<uint16_t>(sqlite3_column_int(stmt, 1));
+        row.banner = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+
+        const unsigned char* ip = sqlite3_column_text(stmt, 3);
+        in_addr addr;
+        row.host = (ip && inet_pton(AF_INET, reinterpret_cast<const char*>(ip), &addr) == 1) ? addr.s_addr : 0;
+        row.ts = sqlite3_column_int64(stmt, 4);
+        rows.push_back(row);
+
+        if (rows.size() == ARCHIVE_BLOCK_ROWS) {
+            if (!(ok = writer.append(rows))) break;
+            exported += rows.size();
+            rows.clear();
+        }
+    }
+    if (ok && rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        ok = false;
+    }
+    if (ok && !rows.empty()) {
+        ok = writer.append(rows);
+        exported += rows.size();
+    }
+    sqlite3_finalize(stmt);
+
+    // One fsync for the whole partition, before the caller drops it
+    if (ok) ok = writer.sync();
+
+    return ok ? exported : -1;
+}
+
+// Move every closed partition that ended more than keepDays - 1 days ago into the columnar archive.
+// A partition is appended (and fsynced) and dropped inside one write transaction; if the run is
+// interrupted before the commit, the next run discards the partial blocks and exports it again.
+int archive_closed_partitions(const ScanDbConfig& config, int keepDays) {
+    // Retention runs after the export so nothing is dropped before it is archived
+    ScanDbConfig schemaOnly = config;
+    schemaOnly.retention_days = 0;
+    if (!init_scan_db(schemaOnly)) return 1;
+
+    sqlite3* db = open_scan_db(config.path);
+    if (!db) return 1;
+
+    const int64_t now = static_cast<int64_t>(std::time(nullptr));
+    const int64_t cutoff = now - static_cast<int64_t>(keepDays - 1) * 86400;
+
+    long long exported = 0;
+    int archived = 0;
+    bool ok = true;
+    std::vector<ScanPartition> partitions = list_partitions(db);
+    for (size_t i = 0; i < partitions.size() && partitions[i].end_ts <= cutoff; ++i) {
+        ok = false;
+
+        // Hold the write lock from the export to the drop: a late result committed in between
+        // would otherwise be dropped without ever reaching the archive
+        char* err_msg = 0;
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, &err_msg) != SQLITE_OK) {
+            std::cerr << "SQL error: " << err_msg << std::endl;
+            sqlite3_free(err_msg);
+            break;
+        }
+
+        long long rows = -1;
+        if (discard_partial_export(db, partitions[i])) rows = export_partition(db, partitions[i]);
+        if (rows < 0 || !drop_partition(db, partitions[i]) || sqlite3_exec(db, "COMMIT;", 0, 0, 0) != SQLITE_OK) {
+            sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+            break;
+        }
+        exported += rows;
+        archived++;
+        ok = true;
+    }
+
+    // Give the freed pages back so the live database stays small. VACUUM rewrites the whole
+    // file under an exclusive lock, so skip it when nothing was dropped.
+    if (archived > 0) {
+        char* err_msg = 0;
+        if (sqlite3_exec(db, "VACUUM;", 0, 0, &err_msg) != SQLITE_OK) {
+            std::cerr << "VACUUM failed, the database keeps its free pages: " << err_msg << std::endl;
+            sqlite3_free(err_msg);
+        }
+    }
+
+    int dropped = ok ? apply_retention(db, config, now) : 0;
+    sqlite3_close(db);
+
+    std::cout << "Archived " << exported << " results to " << ARCHIVE_PATH << std::endl;
+    if (dropped > 0) std::cout << "Dropped " << dropped << " expired partitions" << std::endl;
+    return ok && dropped >= 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    // Number of most recent days that stay in the live database
+    int keepDays = argc > 1 ? std::atoi(argv[1]) : 1;
+    if (keepDays < 1) {
+        std::cerr << "Usage: " << argv[0] << " [days to keep, at least 1]" << std::endl;
+        return 1;
+    }
+
+    return archive_closed_partitions(scan_db_config(), keepDays);
+}
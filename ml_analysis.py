@@ -1,7 +1,42 @@
+import mmap
+import os
 import sqlite3
+import struct
 import numpy as np
 from sklearn.cluster import KMeans
 
+ARCHIVE_PATH = 'network_scanner.archive'
+
+# Block header layout from scan_archive.h
+BLOCK_HEADER = struct.Struct('<4sIIIQqqqIIHHI')
+BLOCK_ROWS = 65536
+
+def align8(n):
+    return (n + 7) & ~7
+
+def load_archived_ports(path=ARCHIVE_PATH):
+    # Read the port column of every complete block straight out of the mapped archive
+    if not os.path.exists(path) or os.path.getsize(path) == 0:
+        return np.empty(0, dtype=np.uint16)
+
+    with open(path, 'rb') as f:
+        mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+    columns = []
+    offset = 0
+    while offset + BLOCK_HEADER.size <= len(mm):
+        (magic, version, rows, dict_count, block_bytes,
+         _, _, _, _, _, _, _, dict_bytes) = BLOCK_HEADER.unpack_from(mm, offset)
+        if magic != b'PSAB' or version != 1 or rows > BLOCK_ROWS or offset + block_bytes > len(mm):
+            break
+
+        port_offset = offset + BLOCK_HEADER.size + align8(rows * 8) + align8(rows * 4)
+        columns.append(np.frombuffer(mm, dtype=np.uint16, count=rows, offset=port_offset))
+        offset += block_bytes
+
+    ports = np.concatenate(columns) if columns else np.empty(0, dtype=np.uint16)
+    return ports.copy()
+
 def run_ml_analysis():
     # Connect to the SQLite database
     conn = sqlite3.connect('network_scanner.db')
@@ -11,8 +46,9 @@ def run_ml_analysis():
     cursor.execute("SELECT port FROM port_scans")
     port_data = cursor.fetchall()
 
-    # Convert the data to a NumPy array
-    port_numbers = np.array([port[0] for port in port_data]).reshape(-1, 1)
+    # Convert the data to a NumPy array, adding the archived history
+    live_ports = np.array([port[0] for port in port_data], dtype=np.uint16)
+    port_numbers = np.concatenate([load_archived_ports(), live_ports]).reshape(-1, 1)
 
     # Check if we have enough data for clustering
     if len(port_numbers) > 1:
@@ -28,4 +64,4 @@ def run_ml_analysis():
     conn.close()
 
 if __name__ == "__main__":
-    run_ml_analysis()
\ No newline at end of file
+    run_ml_analysis()
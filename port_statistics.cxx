@@ -1,64 +1,139 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
 #include <sqlite3.h>
+#include "scan_archive.h"
+#include "scan_db.h"
 
-// Function to calculate basic statistics on the scanned port data
-void run_port_statistics() {
-    sqlite3* db;
-    sqlite3_stmt* stmt;
-    const char* query;
-    int rc;
+const char* WEEKDAY_NAMES[7] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+
+typedef std::vector<std::pair<std::string, long long>> Ranking;
 
-    // Open the SQLite database
-    rc = sqlite3_open("network_scanner.db", &db);
+// Sort name/count pairs by count, highest first
+Ranking rank(const std::map<std::string, long long>& counts) {
+    Ranking ranking(counts.begin(), counts.end());
+    std::stable_sort(ranking.begin(), ranking.end(),
+                     [](const Ranking::value_type& a, const Ranking::value_type& b) { return a.second > b.second; });
+    return ranking;
+}
+
+// Run a "key, count" GROUP BY query against the live table and add its rows to counts
+bool add_live_counts(sqlite3* db, const char* query, long long since, std::map<std::string, long long>& counts) {
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, query, -1, &stmt, 0);
     if (rc != SQLITE_OK) {
-        std::cerr << "Cannot open database: " << sqlite3_errmsg(db) << std::endl;
-        return;
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        return false;
     }
 
-    // Query 1: Find the most frequently open ports
-    query = "SELECT port, COUNT(port) as occurrences FROM port_scans GROUP BY port ORDER BY occurrences DESC LIMIT 5;";
-    rc = sqlite3_prepare_v2(db, query, -1, &stmt, 0);
-    if (rc == SQLITE_OK) {
-        std::cout << "Top 5 Most Frequently Open Ports:\n";
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            int port = sqlite3_column_int(stmt, 0);
-            int occurrences = sqlite3_column_int(stmt, 1);
-            std::cout << "Port: " << port << " | Occurrences: " << occurrences << "\n";
-        }
-        sqlite3_finalize(stmt);
+    sqlite3_bind_int64(stmt, 1, since);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char* key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        counts[key ? key : ""] += sqlite3_column_int64(stmt, 1);
     }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to calculate basic statistics on the scanned port data.
+// Recent results come from the live SQLite table, older ones from the columnar archive.
+int run_port_statistics(long long since) {
+    std::map<std::string, long long> ports, banners, days;
+
+    // Migrate an older database first; retention is left to the scanner and archive_scans
+    ScanDbConfig config = scan_db_config();
+    config.retention_days = 0;
+    if (!init_scan_db(config)) return 1;
+
+    sqlite3* db = open_scan_db(config.path);
+    if (!db) return 1;
+
+    const char* filter = " WHERE ts >= ?1";
+
+    // Query 1: Find the most frequently open ports
+    bool ok = add_live_counts(db, (std::string("SELECT port, COUNT(port) FROM port_scans") + filter +
+                                   " GROUP BY port;").c_str(),
+                              since, ports);
 
     // Query 2: Find the most common banner
-    query = "SELECT banner, COUNT(banner) as occurrences FROM port_scans WHERE banner IS NOT NULL GROUP BY banner ORDER BY occurrences DESC LIMIT 5;";
-    rc = sqlite3_prepare_v2(db, query, -1, &stmt, 0);
-    if (rc == SQLITE_OK) {
-        std::cout << "\nTop 5 Most Common Banners:\n";
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            const char* banner = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-            int occurrences = sqlite3_column_int(stmt, 1);
-            std::cout << "Banner: " << banner << " | Occurrences: " << occurrences << "\n";
-        }
-        sqlite3_finalize(stmt);
+    ok = ok && add_live_counts(db, (std::string("SELECT banner, COUNT(banner) FROM port_scans") + filter +
+                                    " AND banner IS NOT NULL GROUP BY banner;").c_str(),
+                               since, banners);
+
+    // Query 3: Find the day when most ports were open (0 = Sunday, local time)
+    std::map<std::string, long long> weekdays;
+    ok = ok && add_live_counts(db, (std::string("SELECT strftime('%w', ts, 'unixepoch', 'localtime'), COUNT(*) FROM port_scans") +
+                                    filter + " GROUP BY 1;").c_str(),
+                               since, weekdays);
+    for (auto it = weekdays.begin(); it != weekdays.end(); ++it) {
+        days[WEEKDAY_NAMES[std::atoi(it->first.c_str()) % 7]] += it->second;
     }
 
-    // Query 3: Find the day when most ports were open
-    query = "SELECT day, COUNT(day) as occurrences FROM port_scans GROUP BY day ORDER BY occurrences DESC LIMIT 1;";
-    rc = sqlite3_prepare_v2(db, query, -1, &stmt, 0);
-    if (rc == SQLITE_OK) {
-        std::cout << "\nDay With Most Open Ports:\n";
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            const char* day = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-            int occurrences = sqlite3_column_int(stmt, 1);
-            std::cout << "Day: " << day << " | Open Ports: " << occurrences << "\n";
+    sqlite3_close(db);
+    if (!ok) return 1;
+
+    // Same aggregates over the archived history, read through mmap
+    ScanArchive archive;
+    ArchiveCounts archived;
+    if (archive.open("network_scanner.archive")) {
+        ArchiveRange range = archive_full_range();
+        range.ts_from = since;
+        archived = scan_archive_counts(archive, range);
+
+        for (int port = 0; port < 65536; ++port) {
+            if (archived.ports[port]) ports[std::to_string(port)] += archived.ports[port];
+        }
+        for (size_t i = 0; i < archived.banners.size(); ++i) {
+            banners[archived.banners[i].first] += archived.banners[i].second;
         }
-        sqlite3_finalize(stmt);
+        for (int d = 0; d < 7; ++d) {
+            if (archived.weekdays[d]) days[WEEKDAY_NAMES[d]] += archived.weekdays[d];
+        }
+    } else {
+        std::cerr << "Cannot read archive: network_scanner.archive" << std::endl;
+        return 1;
     }
 
-    sqlite3_close(db);
+    Ranking ranking = rank(ports);
+    std::cout << "Top 5 Most Frequently Open Ports:\n";
+    for (size_t i = 0; i < ranking.size() && i < 5; ++i) {
+        std::cout << "Port: " << ranking[i].first << " | Occurrences: " << ranking[i].second << "\n";
+    }
+
+    ranking = rank(banners);
+    std::cout << "\nTop 5 Most Common Banners:\n";
+    for (size_t i = 0; i < ranking.size() && i < 5; ++i) {
+        std::cout << "Banner: " << ranking[i].first << " | Occurrences: " << ranking[i].second << "\n";
+    }
+
+    ranking = rank(days);
+    std::cout << "\nDay With Most Open Ports:\n";
+    if (!ranking.empty()) {
+        std::cout << "Day: " << ranking[0].first << " | Open Ports: " << ranking[0].second << "\n";
+    }
+
+    // Blocks entirely outside the time range are skipped through their min/max index
+    std::cout << "\nArchive: " << archived.rows << " rows in range | Blocks scanned: " << archived.blocks_scanned
+              << " | Blocks skipped: " << archived.blocks_skipped << "\n";
+    return 0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Optionally restrict the statistics to the last N days
+    long long since = 0;
+    if (argc > 1) {
+        since = static_cast<long long>(std::time(nullptr)) - std::atoll(argv[1]) * 86400;
+    }
+
     // Run the statistics function
-    run_port_statistics();
-    return 0;
+    return run_port_statistics(since);
 }
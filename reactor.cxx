@@ -0,0 +1,553 @@
+#include "reactor.h"
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+
+// Open ports are handed to the merger in batches of this size (or sooner, see FLUSH_INTERVAL_NS)
+const size_t RESULT_BATCH = 64;
+const int64_t FLUSH_INTERVAL_NS = 50 * 1000000LL;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ReactorConfig reactorConfig(int reactors) {
+    ReactorConfig config;
+    config.reactors = reactors;
+    config.maxInFlight = 512;
+    config.connectTimeoutMs = scanSettings().connectTimeoutMs;
+    config.bannerTimeoutMs = scanSettings().bannerTimeoutMs;
+
+    const char* cpus = std::getenv("PORTSCAN_CPUS");
+    while (cpus && *cpus) {
+        char* end;
+        long cpu = std::strtol(cpus, &end, 10);
+        if (end == cpus) break;
+        config.cpus.push_back(static_cast<int>(cpu));
+        cpus = *end == ',' ? end + 1 : end;
+    }
+
+    const char* inFlight = std::getenv("PORTSCAN_INFLIGHT");
+    if (inFlight && std::atoi(inFlight) > 0) config.maxInFlight = std::atoi(inFlight);
+
+    return config;
+}
+
+struct OpenPort {
+    int port;
+    ProbeResult result;
+};
+
+// Runs the OpenPortHandler on its own thread for batches pushed by the reactors
+class ResultMerger {
+public:
+    ResultMerger(const std::string& ip, OpenPortHandler handler)
+        : ip_(ip), handler_(handler), finished_(false), thread_(&ResultMerger::run, this) {}
+
+    void push(std::vector<OpenPort>& batch) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batches_.push_back(std::vector<OpenPort>());
+            batches_.back().swap(batch);
+        }
+        cv_.notify_one();
+    }
+
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::deque<std::vector<OpenPort>> batches;
+            bool finished;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return !batches_.empty() || finished_; });
+                batches.swap(batches_);
+                finished = finished_;
+            }
+
+            for (size_t b = 0; b < batches.size(); ++b) {
+                for (size_t i = 0; i < batches[b].size(); ++i) {
+                    handler_(ip_, batches[b][i].port, batches[b][i].result);
+                }
+            }
+            if (finished) break;
+        }
+    }
+
+    std::string ip_;
+    OpenPortHandler handler_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::vector<OpenPort>> batches_;
+    bool finished_;
+    std::thread thread_;
+};
+
+enum ConnectionPhase { CONN_FREE, CONN_CONNECTING, CONN_BANNER, CONN_TLS };
+
+struct Connection {
+    int fd;
+    int port;
+    ConnectionPhase phase;
+    uint32_t generation;        // Bumped on every reuse so stale timers and events are ignored
+    int64_t deadlineNs;
+    bool registered;            // Added to epoll
+    std::unique_ptr<TlsProbe> tls;
+};
+
+struct Timer {
+    int64_t deadlineNs;
+    int slot;
+    uint32_t generation;
+
+    bool operator>(const Timer& other) const { return deadlineNs > other.deadlineNs; }
+};
+
+// One event loop scanning ports firstPort, firstPort + stride, ... up to lastPort
+class Reactor {
+public:
+    Reactor(const sockaddr_in& target, int firstPort, int lastPort, int stride, int maxInFlight,
+            const ReactorConfig& config, int cpu, ResultMerger& merger)
+        : target_(target), nextPort_(firstPort), lastPort_(lastPort), stride_(stride),
+          connectTimeoutNs_(static_cast<int64_t>(config.connectTimeoutMs) * 1000000),
+          bannerTimeoutNs_(static_cast<int64_t>(config.bannerTimeoutMs) * 1000000),
+          cpu_(cpu), merger_(merger), epoll_(-1), active_(0), localErrorLogged_(false), lastFlushNs_(0), connections_(maxInFlight) {
+        for (int i = maxInFlight - 1; i >= 0; --i) {
+            connections_[i].fd = -1;
+            connections_[i].phase = CONN_FREE;
+            connections_[i].generation = 0;
+            connections_[i].registered = false;
+            freeSlots_.push_back(i);
+        }
+        stats_.probes = stats_.open = stats_.closed = stats_.filtered = stats_.skipped = 0;
+        stats_.cpu = -1;
+    }
+
+    void run();
+    const ReactorStats& stats() const { return stats_; }
+
+private:
+    void pin();
+    void launch();
+    void onEvent(int slot, uint32_t events);
+    void onConnected(int slot);
+    void readTls(int slot);
+    void setPhase(int slot, ConnectionPhase phase, uint32_t events, int64_t timeoutNs);
+    void finish(int slot, ProbeStatus status, ProbeResult* result);
+    void release(int slot);
+    void skipPort(const char* what, int error);
+    void abandon(const char* what);
+    void expireTimers(int64_t now);
+    void flush(bool force);
+
+    sockaddr_in target_;
+    int nextPort_;
+    int lastPort_;
+    int stride_;
+    int64_t connectTimeoutNs_;
+    int64_t bannerTimeoutNs_;
+    int cpu_;
+    ResultMerger& merger_;
+
+    int epoll_;
+    int active_;
+    bool localErrorLogged_;
+    int64_t lastFlushNs_;
+    std::vector<Connection> connections_;
+    std::vector<int> freeSlots_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    std::vector<OpenPort> results_;
+    ReactorStats stats_;
+};
+
+void Reactor::pin() {
+    if (cpu_ < 0) return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu_, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        stats_.cpu = cpu_;
+    } else {
+        std::lock_guard<std::mutex> guard(cout_mutex);
+        std::cerr << "Cannot pin reactor to CPU " << cpu_ << std::endl;
+    }
+}
+
+void Reactor::run() {
+    pin();
+
+    epoll_ = epoll_create1(0);
+    if (epoll_ < 0) {
+        abandon("epoll_create1");
+        return;
+    }
+
+    std::vector<epoll_event> events(std::max<size_t>(connections_.size(), 1));
+    while (true) {
+        launch();
+        if (active_ == 0 && nextPort_ > lastPort_) break;
+
+        // Every connection in flight has a timer, so this never waits without a deadline
+        int timeoutMs = 0;
+        if (!timers_.empty()) {
+            int64_t waitNs = timers_.top().deadlineNs - nowNs();
+            timeoutMs = waitNs > 0 ? static_cast<int>((waitNs + 999999) / 1000000) : 0;
+        }
+
+        int ready = epoll_wait(epoll_, events.data(), static_cast<int>(events.size()), timeoutMs);
+        if (ready < 0 && errno != EINTR) {
+            abandon("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int slot = static_cast<int>(events[i].data.u64 & 0xffffffffu);
+            uint32_t generation = static_cast<uint32_t>(events[i].data.u64 >> 32);
+            if (connections_[slot].phase != CONN_FREE && connections_[slot].generation == generation) {
+                onEvent(slot, events[i].events);
+            }
+        }
+
+        int64_t now = nowNs();
+        expireTimers(now);
+        flush(false);
+    }
+
+    flush(true);
+    close(epoll_);
+}
+
+// Local resource shortages that clear up as connections in flight are closed
+static bool isShortage(int error) {
+    return error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM ||
+           error == EAGAIN || error == EADDRNOTAVAIL;
+}
+
+// Start connections until every slot is busy or the shard is done
+void Reactor::launch() {
+    while (!freeSlots_.empty() && nextPort_ <= lastPort_) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            // Out of descriptors or buffers: retry once some connections finish. With
+            // nothing in flight no descriptor will come back, so give up on the port.
+            if (isShortage(errno) && active_ > 0) break;
+            skipPort("socket()", errno);
+            continue;
+        }
+
+        sockaddr_in addr = target_;
+        addr.sin_port = htons(nextPort_);
+        int result = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        int error = result < 0 ? errno : 0;
+
+        // Out of ephemeral ports or buffers says nothing about the target: same as socket() above
+        if (result < 0 && isShortage(error)) {
+            close(fd);
+            if (active_ > 0) break;
+            skipPort("connect()", error);
+            continue;
+        }
+
+        int slot = freeSlots_.back();
+        freeSlots_.pop_back();
+        Connection& conn = connections_[slot];
+        conn.fd = fd;
+        conn.port = nextPort_;
+        conn.registered = false;
+        nextPort_ += stride_;
+        active_++;
+
+        if (result == 0) {
+            onConnected(slot);
+        } else if (error == EINPROGRESS) {
+            setPhase(slot, CONN_CONNECTING, EPOLLOUT, connectTimeoutNs_);
+        } else {
+            finish(slot, error == ECONNREFUSED ? PROBE_CLOSED : PROBE_FILTERED, nullptr);
+        }
+    }
+}
+
+void Reactor::setPhase(int slot, ConnectionPhase phase, uint32_t events, int64_t timeoutNs) {
+    Connection& conn = connections_[slot];
+    conn.phase = phase;
+    conn.deadlineNs = nowNs() + timeoutNs;
+
+    epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = (static_cast<uint64_t>(conn.generation) << 32) | static_cast<uint32_t>(slot);
+    if (epoll_ctl(epoll_, conn.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn.fd, &ev) < 0) {
+        {
+            std::lock_guard<std::mutex> guard(cout_mutex);
+            std::cerr << "epoll_ctl failed for port " << conn.port << ": " << std::strerror(errno) << std::endl;
+        }
+        stats_.skipped++;
+        release(slot);
+        return;
+    }
+    conn.registered = true;
+
+    Timer timer;
+    timer.deadlineNs = conn.deadlineNs;
+    timer.slot = slot;
+    timer.generation = conn.generation;
+    timers_.push(timer);
+}
+
+void Reactor::onEvent(int slot, uint32_t events) {
+    Connection& conn = connections_[slot];
+
+    if (conn.phase == CONN_CONNECTING) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0) error = errno;
+
+        if (error == 0 && (events & EPOLLOUT)) {
+            onConnected(slot);
+        } else {
+            finish(slot, error == ECONNREFUSED ? PROBE_CLOSED : PROBE_FILTERED, nullptr);
+        }
+        return;
+    }
+
+    if (conn.phase == CONN_TLS) {
+        readTls(slot);
+        return;
+    }
+
+    // Banner: whatever the service sends first, or nothing if it closes
+    ProbeResult result;
+    result.status = PROBE_OPEN;
+    char buffer[1024];
+    ssize_t bytes = recv(conn.fd, buffer, sizeof(buffer) - 1, 0);
+    if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (bytes > 0) {
+        buffer[bytes] = '\0';
+        result.banner = buffer;
+    }
+    finish(slot, PROBE_OPEN, &result);
+}
+
+void Reactor::onConnected(int slot) {
+    Connection& conn = connections_[slot];
+
+    if (!isTlsPort(conn.port)) {
+        setPhase(slot, CONN_BANNER, EPOLLIN, bannerTimeoutNs_);
+        return;
+    }
+
+    // TLS services wait for the client: send the ClientHello and let the state machine read the reply
+    conn.tls.reset(new TlsProbe());
+    const std::string& hello = conn.tls->clientHello();
+    if (send(conn.fd, hello.data(), hello.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(hello.size())) {
+        finish(slot, PROBE_OPEN, nullptr);
+        return;
+    }
+    setPhase(slot, CONN_TLS, EPOLLIN, bannerTimeoutNs_);
+}
+
+void Reactor::readTls(int slot) {
+    Connection& conn = connections_[slot];
+    char buffer[4096];
+
+    while (conn.tls->state() == TLS_WANT_READ) {
+        ssize_t bytes = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (bytes <= 0) break;
+        conn.tls->onData(buffer, static_cast<size_t>(bytes));
+    }
+    finish(slot, PROBE_OPEN, nullptr);
+}
+
+void Reactor::finish(int slot, ProbeStatus status, ProbeResult* result) {
+    Connection& conn = connections_[slot];
+
+    if (status == PROBE_OPEN) {
+        OpenPort open;
+        open.port = conn.port;
+        if (result) open.result = *result;
+        open.result.status = PROBE_OPEN;
+        if (conn.tls) open.result.tls = conn.tls->info();
+        results_.push_back(open);
+        stats_.open++;
+    } else if (status == PROBE_CLOSED) {
+        stats_.closed++;
+    } else {
+        stats_.filtered++;
+    }
+    stats_.probes++;
+
+    release(slot);
+}
+
+// Close the connection and free its slot without recording a result
+void Reactor::release(int slot) {
+    Connection& conn = connections_[slot];
+
+    // TLS connections are reset rather than closed, like SocketBackend does
+    if (conn.tls) {
+        resetConnection(conn.fd);
+        conn.tls.reset();
+    } else {
+        close(conn.fd);    // Also removes it from epoll
+    }
+
+    conn.fd = -1;
+    conn.phase = CONN_FREE;
+    conn.generation++;
+    freeSlots_.push_back(slot);
+    active_--;
+}
+
+// Count the next port of the shard as skipped after socket() or connect() failed locally for it
+void Reactor::skipPort(const char* what, int error) {
+    if (!localErrorLogged_) {
+        std::lock_guard<std::mutex> guard(cout_mutex);
+        std::cerr << what << " failed for port " << nextPort_ << ": " << std::strerror(error)
+                  << "; ports are skipped until resources free up" << std::endl;
+        localErrorLogged_ = true;
+    }
+    stats_.skipped++;
+    nextPort_ += stride_;
+}
+
+// The event loop cannot continue: drop the connections in flight and the rest of the shard,
+// counting all of them as skipped
+void Reactor::abandon(const char* what) {
+    int error = errno;
+    uint64_t before = stats_.skipped;
+
+    for (size_t slot = 0; slot < connections_.size(); ++slot) {
+        if (connections_[slot].phase == CONN_FREE) continue;
+        stats_.skipped++;
+        release(static_cast<int>(slot));
+    }
+    if (nextPort_ <= lastPort_) {
+        stats_.skipped += static_cast<uint64_t>((lastPort_ - nextPort_) / stride_ + 1);
+        nextPort_ = lastPort_ + 1;
+    }
+
+    std::lock_guard<std::mutex> guard(cout_mutex);
+    std::cerr << what << " failed: " << std::strerror(error) << "; skipped " << stats_.skipped - before
+              << " ports" << std::endl;
+}
+
+void Reactor::expireTimers(int64_t now) {
+    while (!timers_.empty() && timers_.top().deadlineNs <= now) {
+        Timer timer = timers_.top();
+        timers_.pop();
+
+        Connection& conn = connections_[timer.slot];
+        if (conn.phase == CONN_FREE || conn.generation != timer.generation || conn.deadlineNs != timer.deadlineNs) {
+            continue;    // Connection finished or moved on to its next phase
+        }
+        finish(timer.slot, conn.phase == CONN_CONNECTING ? PROBE_FILTERED : PROBE_OPEN, nullptr);
+    }
+}
+
+void Reactor::flush(bool force) {
+    if (results_.empty()) return;
+
+    int64_t now = nowNs();
+    if (force || results_.size() >= RESULT_BATCH || now - lastFlushNs_ >= FLUSH_INTERVAL_NS) {
+        merger_.push(results_);
+        lastFlushNs_ = now;
+    }
+}
+
+std::vector<ReactorStats> scanPortsWithReactors(const std::string& ip, int startPort, int endPort,
+                                                const ReactorConfig& config, OpenPortHandler handler) {
+    std::vector<ReactorStats> stats;
+    if (endPort < startPort) return stats;
+
+    sockaddr_in target;
+    std::memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    if (inet_pton(AF_INET, ip.c_str(), &target.sin_addr) != 1) {
+        std::cerr << "Invalid IPv4 address: " << ip << std::endl;
+        return stats;
+    }
+
+    // By default reactors go on the CPUs this process may run on, which under a cpuset or
+    // taskset need not be 0..N-1
+    std::vector<int> cpus = config.cpus;
+    if (cpus.empty()) {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+            }
+        }
+        for (int cpu = 0; cpus.empty() && cpu < static_cast<int>(std::thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    int reactors = config.reactors > 0 ? config.reactors : static_cast<int>(cpus.size());
+    reactors = std::max(1, std::min(reactors, endPort - startPort + 1));
+
+    // Every reactor keeps up to maxInFlight sockets open; make room for them if the hard limit allows
+    rlimit files;
+    int maxInFlight = config.maxInFlight;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0) {
+        if (files.rlim_cur < files.rlim_max) {
+            files.rlim_cur = files.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &files);
+            getrlimit(RLIMIT_NOFILE, &files);
+        }
+        if (files.rlim_cur != RLIM_INFINITY) {
+            long perReactor = (static_cast<long>(files.rlim_cur) - 64) / reactors;
+            maxInFlight = static_cast<int>(std::max(1L, std::min(static_cast<long>(maxInFlight), perReactor)));
+        }
+    }
+
+    ResultMerger merger(ip, handler);
+
+    std::vector<std::unique_ptr<Reactor>> loops;
+    for (int r = 0; r < reactors; ++r) {
+        int cpu = cpus.empty() ? -1 : cpus[r % cpus.size()];
+        loops.push_back(std::unique_ptr<Reactor>(
+            new Reactor(target, startPort + r, endPort, reactors, maxInFlight, config, cpu, merger)));
+    }
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < reactors; ++r) {
+        threads.emplace_back(&Reactor::run, loops[r].get());
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    merger.finish();
+
+    for (int r = 0; r < reactors; ++r) stats.push_back(loops[r]->stats());
+    return stats;
+}
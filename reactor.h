@@ -0,0 +1,66 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+/*
+
+Multi-reactor scan engine
+
+	An alternative to the worker()/port_queue thread pool in scanner.cxx. Each reactor
+	is one thread running its own epoll loop, pinned to a CPU, with many non-blocking
+	connections in flight at once. The port range is split up front: reactor r scans
+	every R-th port starting at startPort + r, so reactors never share a queue.
+
+	Each reactor owns its epoll instance, connection slots, timer heap, result buffer
+	and counters. The only shared structure is the merger queue, which takes whole
+	batches of open ports and hands them to the OpenPortHandler on its own thread, so
+	printing and SQLite writes never stall an event loop.
+
+	Open TLS ports are driven through TlsProbe on the same loop, without a thread
+	per handshake.
+
+	Ports that could not be probed because of a local failure (socket() or connect()
+	running out of descriptors, ephemeral ports or buffers with nothing in flight, or
+	the epoll instance itself) are counted in ReactorStats::skipped rather than
+	reported as filtered, so callers can tell an incomplete scan apart.
+
+	The reactors talk to sockets directly rather than through ProbeBackend, whose
+	probe() blocks until the port is done. SimulatedNetwork and VirtualClock therefore
+	only drive the thread pool; the reactors are benchmarked against loopback
+	(scan_bench loopback).
+
+	Settings come from the environment:
+	    PORTSCAN_CPUS=0,2,4,6           CPU for each reactor (default: the CPUs in the process's
+	                                    affinity mask, one reactor each)
+	    PORTSCAN_INFLIGHT=N             connections in flight per reactor (default 512)
+
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "scanner.h"
+
+struct ReactorConfig {
+    int reactors;               // 0 means one per CPU in the affinity mask
+    std::vector<int> cpus;      // Affinity, cycled if shorter than the reactor count
+    int maxInFlight;
+    int connectTimeoutMs;
+    int bannerTimeoutMs;
+};
+
+struct ReactorStats {
+    uint64_t probes;            // Ports with a result: open + closed + filtered
+    uint64_t open;
+    uint64_t closed;
+    uint64_t filtered;
+    uint64_t skipped;           // Ports of the shard left without a result by a local error
+    int cpu;                    // CPU the reactor was pinned to, -1 if pinning failed
+};
+
+ReactorConfig reactorConfig(int reactors);
+
+// Scan [startPort, endPort] on ip; returns the counters of each reactor
+std::vector<ReactorStats> scanPortsWithReactors(const std::string& ip, int startPort, int endPort,
+                                                const ReactorConfig& config, OpenPortHandler handler);
+
+#endif
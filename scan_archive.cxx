@@ -0,0 +1,370 @@
+#include "scan_archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Byte offsets of every section inside a block, relative to its header
+struct BlockLayout {
+    size_t ts, host, port, banner, dict_off, dict, total;
+};
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+static BlockLayout block_layout(size_t rows, size_t dict_count, size_t dict_bytes) {
+    BlockLayout l;
+    l.ts = sizeof(ArchiveBlockHeader);
+    l.host = l.ts + align8(rows * sizeof(int64_t));
+    l.port = l.host + align8(rows * sizeof(uint32_t));
+    l.banner = l.port + align8(rows * sizeof(uint16_t));
+    l.dict_off = l.banner + align8(rows * sizeof(uint32_t));
+    l.dict = l.dict_off + align8((dict_count + 1) * sizeof(uint32_t));
+    l.total = l.dict + align8(dict_bytes);
+    return l;
+}
+
+ScanArchive::ScanArchive() : fd_(-1), map_(nullptr), map_size_(0), valid_bytes_(0) {}
+
+ScanArchive::~ScanArchive() {
+    close();
+}
+
+bool ScanArchive::open(const std::string& path) {
+    close();
+
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        // A missing archive is simply an empty one
+        return errno == ENOENT;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) < 0) {
+        close();
+        return false;
+    }
+
+    map_size_ = static_cast<size_t>(st.st_size);
+    if (map_size_ == 0) return true;
+
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        close();
+        return false;
+    }
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+    // Walk the block chain, stopping at the first block that does not check out
+    const char* base = static_cast<const char*>(map_);
+    size_t offset = 0;
+    while (offset + sizeof(ArchiveBlockHeader) <= map_size_) {
+        const ArchiveBlockHeader* h = reinterpret_cast<const ArchiveBlockHeader*>(base + offset);
+        if (std::memcmp(h->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) break;
+        if (h->version != ARCHIVE_VERSION || h->row_count > ARCHIVE_BLOCK_ROWS) break;
+
+        BlockLayout l = block_layout(h->row_count, h->dict_count, h->dict_bytes);
+        if (h->block_bytes != l.total || l.total > map_size_ - offset) break;
+
+        const char* p = base + offset;
+        ArchiveBlock block;
+        block.offset = offset;
+        block.header = h;
+        block.ts = reinterpret_cast<const int64_t*>(p + l.ts);
+        block.host = reinterpret_cast<const uint32_t*>(p + l.host);
+        block.port = reinterpret_cast<const uint16_t*>(p + l.port);
+        block.banner = reinterpret_cast<const uint32_t*>(p + l.banner);
+        block.dict_off = reinterpret_cast<const uint32_t*>(p + l.dict_off);
+        block.dict = p + l.dict;
+        if (block.dict_off[h->dict_count] != h->dict_bytes) break;
+
+        blocks_.push_back(block);
+        offset += l.total;
+    }
+    valid_bytes_ = offset;
+
+    return true;
+}
+
+void ScanArchive::close() {
+    if (map_) munmap(map_, map_size_);
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    map_ = nullptr;
+    map_size_ = 0;
+    valid_bytes_ = 0;
+    blocks_.clear();
+}
+
+ArchiveRange archive_full_range() {
+    ArchiveRange range;
+    range.ts_from = std::numeric_limits<int64_t>::min();
+    range.ts_to = std::numeric_limits<int64_t>::max();
+    return range;
+}
+
+// Local weekday of an epoch timestamp. Remembers the [start, end) of the last local day it
+// looked up, so rows in time order cost one localtime_r() per day, and days that are 23 or
+// 25 hours long because of a DST change still get the right weekday near midnight.
+struct LocalDays {
+    int64_t start;
+    int64_t end;
+    int wday;
+
+    LocalDays() : start(0), end(0), wday(0) {}
+
+    int weekday(int64_t ts) {
+        if (ts >= start && ts < end) return wday;
+
+        std::time_t t = static_cast<std::time_t>(ts);
+        std::tm local;
+        localtime_r(&t, &local);
+        wday = local.tm_wday;
+
+        std::tm midnight = local;
+        midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+        midnight.tm_isdst = -1;
+        start = static_cast<int64_t>(std::mktime(&midnight));
+        midnight = local;
+        midnight.tm_mday++;
+        midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+        midnight.tm_isdst = -1;
+        end = static_cast<int64_t>(std::mktime(&midnight));
+
+        // mktime() cannot always place midnight (zones that skip it); fall back to this one second
+        if (start > ts || end <= ts) {
+            start = ts;
+            end = ts + 1;
+        }
+        return wday;
+    }
+};
+
+ArchiveCounts scan_archive_counts(const ScanArchive& archive, const ArchiveRange& range) {
+    ArchiveCounts counts;
+    counts.ports.assign(65536, 0);
+    counts.weekdays.assign(7, 0);
+    counts.rows = 0;
+    counts.blocks_scanned = 0;
+    counts.blocks_skipped = 0;
+
+    // Weekdays are reported in local time, like SQLite's 'localtime' modifier on live rows
+    LocalDays days;
+
+    std::unordered_map<std::string, uint64_t> banners;
+    std::vector<uint64_t> banner_hits;
+
+    for (const ArchiveBlock& block : archive.blocks()) {
+        const ArchiveBlockHeader* h = block.header;
+        if (h->ts_max < range.ts_from || h->ts_min > range.ts_to) {
+            counts.blocks_skipped++;
+            continue;
+        }
+        counts.blocks_scanned++;
+
+        const uint32_t n = h->row_count;
+        uint64_t weekdays[7] = {0, 0, 0, 0, 0, 0, 0};
+        banner_hits.assign(h->dict_count, 0);
+
+        if (h->ts_min >= range.ts_from && h->ts_max <= range.ts_to) {
+            // Whole block is inside the range: straight passes over each column
+            for (uint32_t i = 0; i < n; ++i) counts.ports[block.port[i]]++;
+            for (uint32_t i = 0; i < n; ++i) banner_hits[block.banner[i]]++;
+            for (uint32_t i = 0; i < n; ++i) weekdays[days.weekday(block.ts[i])]++;
+            counts.rows += n;
+        } else {
+            for (uint32_t i = 0; i < n; ++i) {
+                const int64_t ts = block.ts[i];
+                if (ts < range.ts_from || ts > range.ts_to) continue;
+                counts.ports[block.port[i]]++;
+                banner_hits[block.banner[i]]++;
+                weekdays[days.weekday(ts)]++;
+                counts.rows++;
+            }
+        }
+
+        for (int d = 0; d < 7; ++d) counts.weekdays[d] += weekdays[d];
+        for (uint32_t id = 0; id < h->dict_count; ++id) {
+            if (banner_hits[id]) banners[block.banner_text(id)] += banner_hits[id];
+        }
+    }
+
+    counts.banners.assign(banners.begin(), banners.end());
+    std::sort(counts.banners.begin(), counts.banners.end(),
+              [](const std::pair<std::string, uint64_t>& a, const std::pair<std::string, uint64_t>& b) {
+                  return a.second > b.second;
+              });
+
+    return counts;
+}
+
+// Serialize rows[begin, end) into a single block
+static void build_block(const std::vector<ArchiveRow>& rows, size_t begin, size_t end, std::vector<char>& out) {
+    const size_t n = end - begin;
+
+    std::unordered_map<std::string, uint32_t> dict_ids;
+    std::vector<const std::string*> dict;
+    std::vector<uint32_t> banner_ids(n);
+    size_t dict_bytes = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const std::string& banner = rows[begin + i].banner;
+        auto it = dict_ids.find(banner);
+        if (it == dict_ids.end()) {
+            it = dict_ids.emplace(banner, static_cast<uint32_t>(dict.size())).first;
+            dict.push_back(&it->first);
+            dict_bytes += banner.size();
+        }
+        banner_ids[i] = it->second;
+    }
+
+    BlockLayout l = block_layout(n, dict.size(), dict_bytes);
+    out.assign(l.total, 0);
+    char* p = out.data();
+
+    ArchiveBlockHeader* h = reinterpret_cast<ArchiveBlockHeader*>(p);
+    std::memcpy(h->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    h->version = ARCHIVE_VERSION;
+    h->row_count = static_cast<uint32_t>(n);
+    h->dict_count = static_cast<uint32_t>(dict.size());
+    h->block_bytes = l.total;
+    h->last_row_id = 0;
+    h->ts_min = std::numeric_limits<int64_t>::max();
+    h->ts_max = std::numeric_limits<int64_t>::min();
+    h->host_min = std::numeric_limits<uint32_t>::max();
+    h->host_max = 0;
+    h->port_min = std::numeric_limits<uint16_t>::max();
+    h->port_max = 0;
+    h->dict_bytes = static_cast<uint32_t>(dict_bytes);
+
+    int64_t* ts = reinterpret_cast<int64_t*>(p + l.ts);
+    uint32_t* host = reinterpret_cast<uint32_t*>(p + l.host);
+    uint16_t* port = reinterpret_cast<uint16_t*>(p + l.port);
+    for (size_t i = 0; i < n; ++i) {
+        const ArchiveRow& row = rows[begin + i];
+        ts[i] = row.ts;
+        host[i] = row.host;
+        port[i] = row.port;
+        h->last_row_id = std::max(h->last_row_id, row.id);
+        h->ts_min = std::min(h->ts_min, row.ts);
+        h->ts_max = std::max(h->ts_max, row.ts);
+        h->host_min = std::min(h->host_min, row.host);
+        h->host_max = std::max(h->host_max, row.host);
+        h->port_min = std::min(h->port_min, row.port);
+        h->port_max = std::max(h->port_max, row.port);
+    }
+    std::memcpy(p + l.banner, banner_ids.data(), n * sizeof(uint32_t));
+
+    uint32_t* dict_off = reinterpret_cast<uint32_t*>(p + l.dict_off);
+    char* dict_data = p + l.dict;
+    uint32_t offset = 0;
+    for (size_t id = 0; id < dict.size(); ++id) {
+        dict_off[id] = offset;
+        std::memcpy(dict_data + offset, dict[id]->data(), dict[id]->size());
+        offset += static_cast<uint32_t>(dict[id]->size());
+    }
+    dict_off[dict.size()] = offset;
+}
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+ArchiveWriter::ArchiveWriter() : fd_(-1) {}
+
+ArchiveWriter::~ArchiveWriter() {
+    close();
+}
+
+bool ArchiveWriter::open(const std::string& path) {
+    close();
+    path_ = path;
+
+    // Find where the last complete block ends so a torn tail gets overwritten
+    size_t valid_bytes;
+    {
+        ScanArchive existing;
+        if (!existing.open(path)) {
+            std::cerr << "Cannot read archive: " << path << std::endl;
+            return false;
+        }
+        valid_bytes = existing.valid_bytes();
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Cannot open archive: " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (ftruncate(fd_, static_cast<off_t>(valid_bytes)) != 0 ||
+        lseek(fd_, static_cast<off_t>(valid_bytes), SEEK_SET) < 0) {
+        std::cerr << "Error writing archive: " << path << ": " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveWriter::append(const std::vector<ArchiveRow>& rows) {
+    if (fd_ < 0) return false;
+
+    std::vector<char> block;
+    for (size_t begin = 0; begin < rows.size(); begin += ARCHIVE_BLOCK_ROWS) {
+        size_t end = std::min(rows.size(), begin + static_cast<size_t>(ARCHIVE_BLOCK_ROWS));
+        build_block(rows, begin, end, block);
+        if (!write_all(fd_, block.data(), block.size())) {
+            std::cerr << "Error writing archive: " << path_ << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArchiveWriter::sync() {
+    if (fd_ < 0) return false;
+    if (fsync(fd_) != 0) {
+        std::cerr << "Error writing archive: " << path_ << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ArchiveWriter::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool truncate_archive(const std::string& path, size_t bytes) {
+    int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open archive: " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    bool ok = ftruncate(fd, static_cast<off_t>(bytes)) == 0 && fsync(fd) == 0;
+    if (!ok) {
+        std::cerr << "Error truncating archive: " << path << ": " << std::strerror(errno) << std::endl;
+    }
+
+    ::close(fd);
+    return ok;
+}
@@ -0,0 +1,143 @@
+#ifndef SCAN_ARCHIVE_H
+#define SCAN_ARCHIVE_H
+
+/*
+
+Columnar scan-history archive
+
+	Closed time periods are moved out of the live SQLite table into an append-only
+	file made of self-contained blocks. Each block stores up to ARCHIVE_BLOCK_ROWS
+	results column by column, so the statistics tools only touch the columns they need:
+
+	    ArchiveBlockHeader   64 bytes, min/max index for the block
+	    int64_t  ts[n]       epoch seconds (UTC)
+	    uint32_t host[n]     IPv4 address, network byte order
+	    uint16_t port[n]
+	    uint32_t banner[n]   index into the block dictionary
+	    uint32_t dict_off[dict_count + 1]
+	    char     dict[dict_bytes]
+
+	Every section starts on an 8-byte boundary. A torn block at the end of the file
+	(crash during export) is ignored by readers and truncated by the next writer.
+
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const char ARCHIVE_MAGIC[4] = {'P', 'S', 'A', 'B'};
+const uint32_t ARCHIVE_VERSION = 1;
+const uint32_t ARCHIVE_BLOCK_ROWS = 65536;
+
+struct ArchiveBlockHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t row_count;
+    uint32_t dict_count;
+    uint64_t block_bytes;   // Header, columns and dictionary
+    int64_t  last_row_id;   // Highest port_scans.id stored in this block
+    int64_t  ts_min;
+    int64_t  ts_max;
+    uint32_t host_min;
+    uint32_t host_max;
+    uint16_t port_min;
+    uint16_t port_max;
+    uint32_t dict_bytes;
+};
+
+static_assert(sizeof(ArchiveBlockHeader) == 64, "archive block header must stay 64 bytes");
+
+// One row handed to the writer
+struct ArchiveRow {
+    int64_t id;             // port_scans.id, unique across partitions
+    int64_t ts;
+    uint32_t host;
+    uint16_t port;
+    std::string banner;
+};
+
+// Read-only view of one block inside the mapped file
+struct ArchiveBlock {
+    size_t offset;          // Position of the header in the file
+    const ArchiveBlockHeader* header;
+    const int64_t* ts;
+    const uint32_t* host;
+    const uint16_t* port;
+    const uint32_t* banner;
+    const uint32_t* dict_off;
+    const char* dict;
+
+    std::string banner_text(uint32_t id) const {
+        return std::string(dict + dict_off[id], dict_off[id + 1] - dict_off[id]);
+    }
+};
+
+// Memory-mapped archive file
+class ScanArchive {
+public:
+    ScanArchive();
+    ~ScanArchive();
+
+    bool open(const std::string& path);
+    void close();
+
+    const std::vector<ArchiveBlock>& blocks() const { return blocks_; }
+    size_t valid_bytes() const { return valid_bytes_; }
+
+private:
+    ScanArchive(const ScanArchive&);
+    ScanArchive& operator=(const ScanArchive&);
+
+    int fd_;
+    void* map_;
+    size_t map_size_;
+    size_t valid_bytes_;
+    std::vector<ArchiveBlock> blocks_;
+};
+
+// Inclusive epoch range used to skip blocks through their min/max index
+struct ArchiveRange {
+    int64_t ts_from;
+    int64_t ts_to;
+};
+
+ArchiveRange archive_full_range();
+
+// Aggregates read by port_statistics, with how many blocks the time range let it skip
+struct ArchiveCounts {
+    std::vector<uint64_t> ports;      // Indexed by port number
+    std::vector<uint64_t> weekdays;   // 0 = Sunday, local time
+    std::vector<std::pair<std::string, uint64_t>> banners;
+    uint64_t rows;
+    uint64_t blocks_scanned;
+    uint64_t blocks_skipped;
+};
+
+ArchiveCounts scan_archive_counts(const ScanArchive& archive, const ArchiveRange& range);
+
+// Appends blocks to the archive through one open file. open() finds the end of the last
+// complete block once; nothing is durable until sync() returns true.
+class ArchiveWriter {
+public:
+    ArchiveWriter();
+    ~ArchiveWriter();
+
+    bool open(const std::string& path);
+    bool append(const std::vector<ArchiveRow>& rows);    // One block per ARCHIVE_BLOCK_ROWS rows
+    bool sync();
+    void close();
+
+private:
+    ArchiveWriter(const ArchiveWriter&);
+    ArchiveWriter& operator=(const ArchiveWriter&);
+
+    std::string path_;
+    int fd_;
+};
+
+// Cut the file back to a block boundary, discarding an interrupted export
+bool truncate_archive(const std::string& path, size_t bytes);
+
+#endif
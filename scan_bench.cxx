@@ -0,0 +1,160 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include "reactor.h"
+#include "scanner.h"
+#include "sim_network.h"
+
+std::atomic<uint64_t> open_ports(0);
+std::atomic<uint64_t> open_checksum(0);
+
+// Count open ports instead of printing or storing them. The checksum is an
+// order-independent fingerprint of which ports were reported, to compare runs.
+void countOpenPort(const std::string& ip, int port, const ProbeResult& result) {
+    uint64_t h = std::hash<std::string>()(ip + ":" + std::to_string(port) + "|" + result.banner);
+    open_ports.fetch_add(1, std::memory_order_relaxed);
+    open_checksum.fetch_xor(h, std::memory_order_relaxed);
+}
+
+// Simulated targets are 10.0.0.0 upwards, every port 1-65535 on each host
+std::string simHost(uint64_t index) {
+    uint32_t host = 0x0a000000u + static_cast<uint32_t>(index);
+    return std::to_string(host >> 24) + "." + std::to_string((host >> 16) & 0xff) + "." +
+           std::to_string((host >> 8) & 0xff) + "." + std::to_string(host & 0xff);
+}
+
+std::string formatDuration(double seconds) {
+    long long total = static_cast<long long>(seconds);
+    char text[64];
+    std::snprintf(text, sizeof(text), "%lldh %02lldm %02llds", total / 3600, (total / 60) % 60, total % 60);
+    return text;
+}
+
+// Run the real worker()/scanPortsOnIP() scheduler against a simulated network and report
+// its CPU cost, plus the wall time the same scan would take on the modelled network
+int run_benchmark(uint64_t probes, int numThreads, uint64_t seed, double maxProbesPerSec) {
+    SimulatedNetwork network(seed, defaultSimHostProfile());
+    VirtualClock clock;
+    ScanSettings settings = defaultScanSettings();
+    settings.maxProbesPerSec = maxProbesPerSec;
+
+    setProbeBackend(&network);
+    setOpenPortHandler(countOpenPort);
+    setScanClock(&clock);
+    setScanSettings(settings);
+
+    const uint64_t portsPerHost = 65535;
+    const uint64_t hosts = (probes + portsPerHost - 1) / portsPerHost;
+
+    std::clock_t cpuStart = std::clock();
+    std::chrono::steady_clock::time_point realStart = std::chrono::steady_clock::now();
+
+    for (uint64_t h = 0; h < hosts; ++h) {
+        int endPort = static_cast<int>(std::min(portsPerHost, probes - h * portsPerHost));
+        scanPortsOnIP(simHost(h), 1, endPort, numThreads);
+    }
+
+    double cpuSeconds = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    double realSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - realStart).count();
+    double simulatedSeconds = clock.now() / 1e9;
+
+    setProbeBackend(nullptr);
+    setOpenPortHandler(nullptr);
+    setScanClock(nullptr);
+    setScanSettings(defaultScanSettings());
+
+    SimStats stats = network.stats();
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Probes: " << stats.probes << " on " << hosts << " hosts | Threads: " << numThreads
+              << " | Seed: " << seed << "\n";
+    std::cout << "Open: " << stats.open << " | Closed: " << stats.closed << " | Filtered: " << stats.filtered
+              << " | Lost: " << stats.lost << "\n";
+    std::cout << "Open port checksum: " << std::hex << open_checksum.load() << std::dec
+              << " (" << open_ports.load() << " reported)\n";
+    std::cout << "CPU time: " << cpuSeconds << " s | Real time: " << realSeconds << " s | "
+              << static_cast<uint64_t>(stats.probes / std::max(cpuSeconds, 1e-9)) << " probes per CPU second\n";
+    std::cout << "Simulated wall time: " << formatDuration(simulatedSeconds) << " | "
+              << static_cast<uint64_t>(stats.probes / std::max(simulatedSeconds, 1e-9)) << " simulated probes/sec\n";
+
+    // Summed probe time over wall time is the average number of probes in flight
+    double probeSeconds = stats.virtualUs / 1e6;
+    std::cout << "Summed probe time: " << formatDuration(probeSeconds) << " | "
+              << probeSeconds / std::max(simulatedSeconds, 1e-9) << " probes in flight on average\n";
+
+    return open_ports.load() == stats.open ? 0 : 1;
+}
+
+// Scan every port on 127.0.0.1 with 1, 2, 4 ... maxReactors reactors. Closed loopback ports
+// refuse instantly, so the rate is bound by the event loops' CPU rather than the network.
+int run_loopback(int maxReactors, int endPort) {
+    std::cout << std::fixed << std::setprecision(2);
+
+    std::vector<int> counts;
+    for (int reactors = 1; reactors < maxReactors; reactors *= 2) counts.push_back(reactors);
+    counts.push_back(maxReactors);
+
+    double baseline = 0;
+    for (size_t c = 0; c < counts.size(); ++c) {
+        int reactors = counts[c];
+        open_ports = 0;
+        open_checksum = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<ReactorStats> stats = scanPortsWithReactors("127.0.0.1", 1, endPort, reactorConfig(reactors), countOpenPort);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t probes = 0, open = 0, skipped = 0;
+        for (size_t r = 0; r < stats.size(); ++r) {
+            probes += stats[r].probes;
+            open += stats[r].open;
+            skipped += stats[r].skipped;
+        }
+        double rate = probes / std::max(seconds, 1e-9);
+        if (c == 0) baseline = rate;
+
+        std::cout << "Reactors: " << reactors << " | Probes: " << probes << " | Open: " << open
+                  << " | Skipped: " << skipped
+                  << " | " << static_cast<uint64_t>(rate) << " probes/sec | Speedup: " << rate / baseline << "x\n";
+        for (size_t r = 0; r < stats.size(); ++r) {
+            std::cout << "  reactor " << r << " cpu " << stats[r].cpu << ": " << stats[r].probes << " probes, "
+                      << stats[r].open << " open, " << stats[r].closed << " closed, " << stats[r].filtered << " filtered, "
+                      << stats[r].skipped << " skipped\n";
+        }
+
+        if (open_ports.load() != open || skipped > 0) return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "loopback") {
+        int maxReactors = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+        int endPort = argc > 3 ? std::atoi(argv[3]) : 65535;
+        if (maxReactors < 1 || endPort < 1 || endPort > 65535) {
+            std::cerr << "Usage: " << argv[0] << " loopback [max reactors] [end port]" << std::endl;
+            return 1;
+        }
+        return run_loopback(maxReactors, endPort);
+    }
+
+    uint64_t probes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    int numThreads = argc > 2 ? std::atoi(argv[2]) : 64;
+    uint64_t seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+    double maxProbesPerSec = argc > 4 ? std::atof(argv[4]) : 0;
+
+    if (probes == 0 || numThreads < 1) {
+        std::cerr << "Usage: " << argv[0] << " [probes] [threads] [seed] [max probes/sec]\n"
+                  << "       " << argv[0] << " loopback [max reactors] [end port]" << std::endl;
+        return 1;
+    }
+
+    return run_benchmark(probes, numThreads, seed, maxProbesPerSec);
+}
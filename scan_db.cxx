@@ -0,0 +1,411 @@
+#include "scan_db.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+// Columns of every partition table, in view order
+const char* PARTITION_COLUMNS =
+    "id, port, banner, ip_address, ts, tls_version, cert_subject, cert_issuer, cert_san, cert_not_after";
+
+// Keep each UNION ALL below SQLite's compound select limit (500 by default)
+const size_t VIEW_GROUP_SIZE = 250;
+
+static bool exec_sql(sqlite3* db, const std::string& sql) {
+    char* err_msg = 0;
+    if (sqlite3_exec(db, sql.c_str(), 0, 0, &err_msg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        return false;
+    }
+    return true;
+}
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+int64_t rollup_bucket_start(int64_t ts, const std::string& granularity) {
+    if (granularity == "hour") return floor_div(ts, 3600) * 3600;
+
+    int64_t day = floor_div(ts, 86400);
+    if (granularity == "week") {
+        // 1970-01-01 was a Thursday, so Monday is three days before a multiple of seven
+        day -= ((day + 3) % 7 + 7) % 7;
+    }
+    return day * 86400;
+}
+
+ScanDbConfig scan_db_config() {
+    ScanDbConfig config;
+    config.path = "network_scanner.db";
+    config.partition = PARTITION_DAY;
+    config.retention_days = 0;
+
+    const char* partition = std::getenv("PORTSCAN_PARTITION");
+    if (partition && std::strcmp(partition, "week") == 0) config.partition = PARTITION_WEEK;
+
+    const char* retention = std::getenv("PORTSCAN_RETENTION_DAYS");
+    if (retention) config.retention_days = std::atoi(retention);
+
+    return config;
+}
+
+sqlite3* open_scan_db(const std::string& path) {
+    sqlite3* db;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "Cannot open database: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return nullptr;
+    }
+    sqlite3_busy_timeout(db, 5000);
+    return db;
+}
+
+std::vector<ScanPartition> list_partitions(sqlite3* db) {
+    std::vector<ScanPartition> partitions;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT name, start_ts, end_ts FROM scan_partitions ORDER BY start_ts;", -1, &stmt, 0) != SQLITE_OK) {
+        return partitions;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        ScanPartition partition;
+        partition.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        partition.start_ts = sqlite3_column_int64(stmt, 1);
+        partition.end_ts = sqlite3_column_int64(stmt, 2);
+        partitions.push_back(partition);
+    }
+    sqlite3_finalize(stmt);
+    return partitions;
+}
+
+// Recreate the port_scans view over the current set of partitions
+static bool rebuild_view(sqlite3* db) {
+    std::vector<std::string> old_groups;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT name FROM sqlite_master WHERE type = 'view' AND name LIKE 'port_scans_group_%';",
+                           -1, &stmt, 0) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            old_groups.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    if (!exec_sql(db, "DROP VIEW IF EXISTS port_scans;")) return false;
+    for (size_t i = 0; i < old_groups.size(); ++i) {
+        if (!exec_sql(db, "DROP VIEW IF EXISTS " + old_groups[i] + ";")) return false;
+    }
+
+    std::vector<ScanPartition> partitions = list_partitions(db);
+    if (partitions.empty()) {
+        return exec_sql(db, "CREATE VIEW port_scans AS SELECT NULL AS id, NULL AS port, NULL AS banner, "
+                            "NULL AS ip_address, NULL AS ts, NULL AS tls_version, NULL AS cert_subject, "
+                            "NULL AS cert_issuer, NULL AS cert_san, NULL AS cert_not_after WHERE 0;");
+    }
+
+    std::vector<std::string> sources;
+    for (size_t i = 0; i < partitions.size(); ++i) sources.push_back(partitions[i].name);
+
+    // Large partition sets are unioned in groups, then the groups are unioned
+    if (sources.size() > VIEW_GROUP_SIZE) {
+        std::vector<std::string> groups;
+        for (size_t begin = 0; begin < sources.size(); begin += VIEW_GROUP_SIZE) {
+            std::string group = "port_scans_group_" + std::to_string(groups.size());
+            std::string sql = "CREATE VIEW " + group + " AS ";
+            for (size_t i = begin; i < sources.size() && i < begin + VIEW_GROUP_SIZE; ++i) {
+                if (i > begin) sql += " UNION ALL ";
+                sql += std::string("SELECT ") + PARTITION_COLUMNS + " FROM " + sources[i];
+            }
+            if (!exec_sql(db, sql + ";")) return false;
+            groups.push_back(group);
+        }
+        sources = groups;
+    }
+
+    std::string sql = "CREATE VIEW port_scans AS ";
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (i > 0) sql += " UNION ALL ";
+        sql += std::string("SELECT ") + PARTITION_COLUMNS + " FROM " + sources[i];
+    }
+    return exec_sql(db, sql + ";");
+}
+
+// Read a single integer (or NULL) from a query with at most one bound integer parameter
+static bool query_int64(sqlite3* db, const char* sql, int64_t param, int64_t& value) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return false;
+    sqlite3_bind_int64(stmt, 1, param);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL;
+    if (found) value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Find the partition covering ts, creating it if needed. Must run inside a write transaction.
+static bool find_or_create_partition(sqlite3* db, const ScanDbConfig& config, int64_t ts, ScanPartition& partition) {
+    sqlite3_stmt* stmt;
+    const char* find_sql = "SELECT name, start_ts, end_ts FROM scan_partitions WHERE start_ts <= ?1 AND ?1 < end_ts;";
+    if (sqlite3_prepare_v2(db, find_sql, -1, &stmt, 0) != SQLITE_OK) return false;
+    sqlite3_bind_int64(stmt, 1, ts);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) {
+        partition.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        partition.start_ts = sqlite3_column_int64(stmt, 1);
+        partition.end_ts = sqlite3_column_int64(stmt, 2);
+    }
+    sqlite3_finalize(stmt);
+    if (found) return true;
+
+    if (config.partition == PARTITION_WEEK) {
+        partition.start_ts = rollup_bucket_start(ts, "week");
+        partition.end_ts = partition.start_ts + 7 * 86400;
+    } else {
+        partition.start_ts = rollup_bucket_start(ts, "day");
+        partition.end_ts = partition.start_ts + 86400;
+    }
+
+    // Partitions never overlap, even after switching between day and week
+    int64_t neighbour;
+    if (query_int64(db, "SELECT MAX(end_ts) FROM scan_partitions WHERE end_ts <= ?1;", ts, neighbour) &&
+        neighbour > partition.start_ts) {
+        partition.start_ts = neighbour;
+    }
+    if (query_int64(db, "SELECT MIN(start_ts) FROM scan_partitions WHERE start_ts > ?1;", ts, neighbour) &&
+        neighbour < partition.end_ts) {
+        partition.end_ts = neighbour;
+    }
+
+    std::time_t start = static_cast<std::time_t>(partition.start_ts);
+    std::tm utc;
+    gmtime_r(&start, &utc);
+    char name[32];
+    std::strftime(name, sizeof(name), "port_scans_%Y%m%d", &utc);
+    partition.name = name;
+
+    if (!exec_sql(db, "CREATE TABLE IF NOT EXISTS " + partition.name + " ("
+                      "id INTEGER PRIMARY KEY,"
+                      "port INTEGER,"
+                      "banner TEXT,"
+                      "ip_address TEXT,"
+                      "ts INTEGER,"
+                      "tls_version TEXT,"
+                      "cert_subject TEXT,"
+                      "cert_issuer TEXT,"
+                      "cert_san TEXT,"
+                      "cert_not_after INTEGER"
+                      ");")) {
+        return false;
+    }
+
+    const char* register_sql = "INSERT INTO scan_partitions (name, start_ts, end_ts) VALUES (?1, ?2, ?3);";
+    if (sqlite3_prepare_v2(db, register_sql, -1, &stmt, 0) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, partition.name.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, partition.start_ts);
+    sqlite3_bind_int64(stmt, 3, partition.end_ts);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    return rebuild_view(db);
+}
+
+// Move the rows of a pre-partitioning port_scans table (TEXT timestamps) into partitions
+static bool migrate_legacy_table(sqlite3* db, const ScanDbConfig& config) {
+    if (!exec_sql(db, "ALTER TABLE port_scans RENAME TO port_scans_legacy;")) return false;
+
+    const std::string legacy =
+        "(SELECT id, port, banner, ip_address, CAST(strftime('%s', timestamp, 'utc') AS INTEGER) AS e "
+        "FROM port_scans_legacy WHERE timestamp IS NOT NULL)";
+
+    std::vector<int64_t> days;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, ("SELECT DISTINCT e / 86400 FROM " + legacy + " ORDER BY 1;").c_str(), -1, &stmt, 0) != SQLITE_OK) {
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) days.push_back(sqlite3_column_int64(stmt, 0));
+    sqlite3_finalize(stmt);
+
+    for (size_t i = 0; i < days.size(); ++i) {
+        ScanPartition partition;
+        if (!find_or_create_partition(db, config, days[i] * 86400, partition)) return false;
+        if (!exec_sql(db, "INSERT INTO " + partition.name + " (id, port, banner, ip_address, ts) "
+                          "SELECT id, port, banner, ip_address, e FROM " + legacy +
+                          " WHERE e >= " + std::to_string(days[i] * 86400) +
+                          " AND e < " + std::to_string((days[i] + 1) * 86400) + " ORDER BY id;")) {
+            return false;
+        }
+    }
+
+    const std::string buckets[3] = {
+        "e - e % 3600",
+        "e - e % 86400",
+        "(e / 86400 - (e / 86400 + 3) % 7) * 86400",
+    };
+    for (int g = 0; g < 3; ++g) {
+        if (!exec_sql(db, std::string("INSERT INTO scan_rollups (granularity, bucket_start, ip_address, port, open_count) "
+                                      "SELECT '") + ROLLUP_GRANULARITIES[g] + "', " + buckets[g] +
+                          ", ip_address, port, COUNT(*) FROM " + legacy + " WHERE e IS NOT NULL "
+                          "GROUP BY 2, 3, 4 "
+                          "ON CONFLICT (granularity, bucket_start, ip_address, port) "
+                          "DO UPDATE SET open_count = open_count + excluded.open_count;")) {
+            return false;
+        }
+    }
+
+    return exec_sql(db, "DROP TABLE port_scans_legacy;");
+}
+
+// Take the next id from scan_sequence. Must run inside a write transaction.
+static bool allocate_scan_id(sqlite3* db, int64_t& id) {
+    return exec_sql(db, "UPDATE scan_sequence SET next_id = next_id + 1;") &&
+           query_int64(db, "SELECT next_id - 1 FROM scan_sequence", 0, id);
+}
+
+bool init_scan_db(const ScanDbConfig& config) {
+    sqlite3* db = open_scan_db(config.path);
+    if (!db) return false;
+
+    bool ok = exec_sql(db, "BEGIN IMMEDIATE;") &&
+              exec_sql(db, "CREATE TABLE IF NOT EXISTS scan_partitions ("
+                           "name TEXT PRIMARY KEY,"
+                           "start_ts INTEGER NOT NULL,"
+                           "end_ts INTEGER NOT NULL"
+                           ");") &&
+              exec_sql(db, "CREATE TABLE IF NOT EXISTS scan_rollups ("
+                           "granularity TEXT NOT NULL,"
+                           "bucket_start INTEGER NOT NULL,"
+                           "ip_address TEXT NOT NULL,"
+                           "port INTEGER NOT NULL,"
+                           "open_count INTEGER NOT NULL,"
+                           "PRIMARY KEY (granularity, bucket_start, ip_address, port)"
+                           ") WITHOUT ROWID;") &&
+              exec_sql(db, "CREATE TABLE IF NOT EXISTS scan_sequence (next_id INTEGER NOT NULL);");
+
+    if (ok) {
+        int64_t legacy = 0;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'port_scans';",
+                               -1, &stmt, 0) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) legacy = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+        ok = legacy ? migrate_legacy_table(db, config) : rebuild_view(db);
+
+        // Migrated rows keep their AUTOINCREMENT ids; new ids continue after the highest
+        int64_t has_sequence = 0;
+        if (ok && !query_int64(db, "SELECT COUNT(*) FROM scan_sequence;", 0, has_sequence)) ok = false;
+        if (ok && !has_sequence) {
+            ok = exec_sql(db, "INSERT INTO scan_sequence (next_id) SELECT COALESCE(MAX(id), 0) + 1 FROM port_scans;");
+        }
+    }
+
+    ok = ok && exec_sql(db, "COMMIT;");
+    if (!ok) exec_sql(db, "ROLLBACK;");
+
+    if (ok && apply_retention(db, config, static_cast<int64_t>(std::time(nullptr))) < 0) ok = false;
+
+    sqlite3_close(db);
+    return ok;
+}
+
+bool store_scan_result(sqlite3* db, const ScanDbConfig& config, int port, const std::string& banner,
+                       const std::string& ip_address, int64_t ts, const TlsCertInfo& tls) {
+    if (!exec_sql(db, "BEGIN IMMEDIATE;")) return false;
+
+    ScanPartition partition;
+    int64_t id = 0;
+    bool ok = find_or_create_partition(db, config, ts, partition) && allocate_scan_id(db, id);
+
+    sqlite3_stmt* stmt;
+    if (ok) {
+        std::string sql = "INSERT INTO " + partition.name + " (port, banner, ip_address, ts, tls_version, "
+                          "cert_subject, cert_issuer, cert_san, cert_not_after, id) "
+                          "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10);";
+        ok = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) == SQLITE_OK;
+        if (ok) {
+            sqlite3_bind_int(stmt, 1, port);
+            sqlite3_bind_text(stmt, 2, banner.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, ip_address.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 4, ts);
+
+            // Certificate columns stay NULL unless a TLS handshake got as far as a ServerHello
+            if (!tls.version.empty()) {
+                sqlite3_bind_text(stmt, 5, tls.version.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(stmt, 6, tls.subject.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(stmt, 7, tls.issuer.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(stmt, 8, tls.san.c_str(), -1, SQLITE_TRANSIENT);
+                if (tls.notAfter) sqlite3_bind_int64(stmt, 9, tls.notAfter);
+            }
+            sqlite3_bind_int64(stmt, 10, id);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    const char* rollup_sql =
+        "INSERT INTO scan_rollups (granularity, bucket_start, ip_address, port, open_count) VALUES (?1, ?2, ?3, ?4, 1) "
+        "ON CONFLICT (granularity, bucket_start, ip_address, port) DO UPDATE SET open_count = open_count + 1;";
+    if (ok) ok = sqlite3_prepare_v2(db, rollup_sql, -1, &stmt, 0) == SQLITE_OK;
+    if (ok) {
+        for (int g = 0; ok && g < 3; ++g) {
+            sqlite3_bind_text(stmt, 1, ROLLUP_GRANULARITIES[g], -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 2, rollup_bucket_start(ts, ROLLUP_GRANULARITIES[g]));
+            sqlite3_bind_text(stmt, 3, ip_address.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 4, port);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    if (ok) ok = exec_sql(db, "COMMIT;");
+    if (!ok) {
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        exec_sql(db, "ROLLBACK;");
+    }
+    return ok;
+}
+
+bool drop_partition(sqlite3* db, const ScanPartition& partition) {
+    if (!exec_sql(db, "DROP TABLE IF EXISTS " + partition.name + ";")) return false;
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "DELETE FROM scan_partitions WHERE name = ?1;", -1, &stmt, 0) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, partition.name.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+
+    return ok && rebuild_view(db);
+}
+
+int apply_retention(sqlite3* db, const ScanDbConfig& config, int64_t now) {
+    if (config.retention_days <= 0) return 0;
+
+    const int64_t cutoff = now - static_cast<int64_t>(config.retention_days) * 86400;
+    if (!exec_sql(db, "BEGIN IMMEDIATE;")) return -1;
+
+    int dropped = 0;
+    bool ok = true;
+    std::vector<ScanPartition> partitions = list_partitions(db);
+    for (size_t i = 0; ok && i < partitions.size() && partitions[i].end_ts <= cutoff; ++i) {
+        ok = drop_partition(db, partitions[i]);
+        dropped++;
+    }
+
+    // Hourly rollups follow the raw data; daily and weekly ones are kept for trend reports
+    if (ok) ok = exec_sql(db, "DELETE FROM scan_rollups WHERE granularity = 'hour' AND bucket_start < " +
+                              std::to_string(cutoff) + ";");
+
+    if (ok) ok = exec_sql(db, "COMMIT;");
+    if (!ok) {
+        exec_sql(db, "ROLLBACK;");
+        return -1;
+    }
+    return dropped;
+}
@@ -0,0 +1,77 @@
+#ifndef SCAN_DB_H
+#define SCAN_DB_H
+
+/*
+
+Scan database layout
+
+	Results are stored with an integer epoch timestamp (UTC seconds) in one table per
+	time partition, port_scans_YYYYMMDD, named after the UTC day the partition starts.
+	scan_partitions lists every partition and the [start_ts, end_ts) range it covers,
+	and the port_scans view unions them so readers never need to know about partitions.
+	Row ids are unique across partitions: store_scan_result() takes them from the single
+	row in scan_sequence, so ids keep growing in insert order.
+
+	Open TLS ports also carry the negotiated version and the leaf certificate's
+	subject, issuer, SAN and expiry (epoch) in the tls_version and cert_* columns.
+
+	Retention drops whole partitions once they fall out of the window, which is a
+	cheap DROP TABLE instead of a DELETE over millions of rows.
+
+	scan_rollups holds open-port counts per host and port at hourly, daily and weekly
+	granularity. It is updated with every insert and outlives the raw partitions
+	(hourly buckets follow the retention window), so trend reports stay cheap.
+
+	Settings come from the environment:
+	    PORTSCAN_PARTITION=day|week     size of new partitions (default day)
+	    PORTSCAN_RETENTION_DAYS=N       drop partitions that ended more than N days ago (0 keeps everything)
+
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "tls_cert.h"
+
+enum PartitionGranularity { PARTITION_DAY, PARTITION_WEEK };
+
+struct ScanDbConfig {
+    std::string path;
+    PartitionGranularity partition;
+    int retention_days;
+};
+
+struct ScanPartition {
+    std::string name;
+    int64_t start_ts;
+    int64_t end_ts;
+};
+
+// Rollup granularities, as stored in scan_rollups.granularity
+const char* const ROLLUP_GRANULARITIES[3] = {"hour", "day", "week"};
+
+ScanDbConfig scan_db_config();
+
+// Open the database with a busy timeout so concurrent writers wait instead of failing
+sqlite3* open_scan_db(const std::string& path);
+
+// Create the schema, migrate a legacy port_scans table and apply retention
+bool init_scan_db(const ScanDbConfig& config);
+
+// Insert one open port into its partition and update the rollups
+bool store_scan_result(sqlite3* db, const ScanDbConfig& config, int port, const std::string& banner,
+                       const std::string& ip_address, int64_t ts, const TlsCertInfo& tls = TlsCertInfo());
+
+std::vector<ScanPartition> list_partitions(sqlite3* db);
+
+// Drop a partition and rebuild the port_scans view. Runs inside the caller's transaction, if any.
+bool drop_partition(sqlite3* db, const ScanPartition& partition);
+
+// Drop partitions that ended before the retention window; returns the number dropped or -1
+int apply_retention(sqlite3* db, const ScanDbConfig& config, int64_t now);
+
+// Start of the rollup bucket containing ts (UTC, weeks start on Monday)
+int64_t rollup_bucket_start(int64_t ts, const std::string& granularity);
+
+#endif
@@ -0,0 +1,300 @@
+#include "scanner.h"
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <queue>
+#include <condition_variable>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>       // For fcntl()
+#include <sys/select.h>  // For select()
+#include <errno.h>
+#include <ctime>
+#include <algorithm>
+
+std::mutex cout_mutex;
+std::mutex queue_mutex;
+std::condition_variable cv;
+std::queue<int> port_queue;
+bool done = false;
+
+void printOpenPort(const std::string& ip, int port, const ProbeResult& result) {
+    std::string output = "Port " + std::to_string(port) + " is open on " + ip;
+    if (!result.banner.empty()) output += " | Banner: " + result.banner;
+    if (!result.tls.version.empty()) {
+        output += " | " + result.tls.version;
+        if (!result.tls.subject.empty()) output += " | Subject: " + result.tls.subject;
+        if (!result.tls.san.empty()) output += " | SAN: " + result.tls.san;
+        if (!result.tls.issuer.empty()) output += " | Issuer: " + result.tls.issuer;
+        if (result.tls.notAfter) {
+            std::time_t expiry = static_cast<std::time_t>(result.tls.notAfter);
+            std::tm utc;
+            gmtime_r(&expiry, &utc);
+            char date[16];
+            std::strftime(date, sizeof(date), "%Y-%m-%d", &utc);
+            output += std::string(" | Expires: ") + date;
+        }
+    }
+
+    // Thread-safe output
+    std::lock_guard<std::mutex> guard(cout_mutex);
+    std::cout << output << std::endl;
+}
+
+ScanSettings defaultScanSettings() {
+    ScanSettings settings;
+    settings.connectTimeoutMs = 1000;
+    settings.bannerTimeoutMs = 1000;
+    settings.maxProbesPerSec = 0;
+    return settings;
+}
+
+static SocketBackend default_backend;
+static RealClock default_clock;
+static ProbeBackend* probe_backend = &default_backend;
+static OpenPortHandler open_port_handler = printOpenPort;
+static ScanClock* scan_clock = &default_clock;
+static ScanSettings scan_settings = defaultScanSettings();
+
+void setProbeBackend(ProbeBackend* backend) {
+    probe_backend = backend ? backend : &default_backend;
+}
+
+void setOpenPortHandler(OpenPortHandler handler) {
+    open_port_handler = handler ? handler : printOpenPort;
+}
+
+void setScanClock(ScanClock* clock) {
+    scan_clock = clock ? clock : &default_clock;
+}
+
+void setScanSettings(const ScanSettings& settings) {
+    scan_settings = settings;
+}
+
+const ScanSettings& scanSettings() {
+    return scan_settings;
+}
+
+static uint64_t steadyNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+RealClock::RealClock() : intervalNs_(0), nextStartNs_(0) {}
+
+void RealClock::begin(int, double maxProbesPerSec) {
+    intervalNs_ = maxProbesPerSec > 0 ? static_cast<uint64_t>(1e9 / maxProbesPerSec) : 0;
+    nextStartNs_ = 0;
+}
+
+// Runs under the queue lock, so slots are handed out in dequeue order without a lock of its own
+uint64_t RealClock::dequeued() {
+    if (intervalNs_ == 0) return 0;
+    uint64_t start = std::max(steadyNs(), nextStartNs_);
+    nextStartNs_ = start + intervalNs_;
+    return start;
+}
+
+void RealClock::waitForSlot(uint64_t ticket) {
+    uint64_t now = steadyNs();
+    if (ticket > now) std::this_thread::sleep_for(std::chrono::nanoseconds(ticket - now));
+}
+
+void RealClock::finished(uint64_t, uint32_t) {}
+
+void resetConnection(int sockfd) {
+    struct linger lin;
+    lin.l_onoff = 1;
+    lin.l_linger = 0;
+    setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+    close(sockfd);
+}
+
+// Drive a TlsProbe over the connected socket until it finishes or the banner timeout expires
+void SocketBackend::readCertificate(int sockfd, int timeoutMs, TlsCertInfo& tls) {
+    TlsProbe handshake;
+    const std::string& hello = handshake.clientHello();
+    if (send(sockfd, hello.data(), hello.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(hello.size())) return;
+
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    while (handshake.state() == TLS_WANT_READ) {
+        long long remainingUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remainingUs <= 0) break;
+
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(sockfd, &rfds);
+        struct timeval tv;
+        tv.tv_sec = remainingUs / 1000000;
+        tv.tv_usec = remainingUs % 1000000;
+        if (select(sockfd + 1, &rfds, NULL, NULL, &tv) <= 0) break;
+
+        char buffer[4096];
+        ssize_t bytes = recv(sockfd, buffer, sizeof(buffer), 0);
+        if (bytes <= 0) break;
+        handshake.onData(buffer, static_cast<size_t>(bytes));
+    }
+
+    tls = handshake.info();
+}
+
+ProbeResult SocketBackend::probe(const std::string& ip, int port, const ScanSettings& settings) {
+    uint64_t startNs = steadyNs();
+    ProbeResult probe = probeSocket(ip, port, settings);
+    probe.durationUs = static_cast<uint32_t>((steadyNs() - startNs) / 1000);
+    return probe;
+}
+
+ProbeResult SocketBackend::probeSocket(const std::string& ip, int port, const ScanSettings& settings) {
+    ProbeResult probe;
+    probe.status = PROBE_FILTERED;
+    probe.durationUs = 0;
+
+    int sockfd;
+    sockaddr_in addr;
+
+    // Create socket
+    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) return probe; // Socket creation failed
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip.c_str(), &addr.sin_addr);
+
+    // Set socket to non-blocking
+    fcntl(sockfd, F_SETFL, O_NONBLOCK);
+
+    // Try to connect
+    int result = connect(sockfd, (sockaddr*)&addr, sizeof(addr));
+
+    // Check if connection is in progress or already connected
+    if (result < 0 && errno != EINPROGRESS) {
+        // Connection failed immediately
+        probe.status = PROBE_CLOSED;
+        close(sockfd);
+        return probe;
+    }
+
+    // Use select to wait for the socket to become writable (connected) or for an error
+    fd_set wfds;
+    struct timeval tv;
+    FD_ZERO(&wfds);
+    FD_SET(sockfd, &wfds);
+    tv.tv_sec = settings.connectTimeoutMs / 1000;
+    tv.tv_usec = (settings.connectTimeoutMs % 1000) * 1000;
+
+    result = select(sockfd + 1, NULL, &wfds, NULL, &tv);
+    if (result > 0 && FD_ISSET(sockfd, &wfds)) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+
+        // Check for socket errors
+        if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+            close(sockfd);
+            return probe;
+        }
+
+        if (error == 0) {
+            // Connection successful
+            probe.status = PROBE_OPEN;
+
+            // TLS services wait for the client to speak, so ask for the certificate instead
+            if (isTlsPort(port)) {
+                readCertificate(sockfd, settings.bannerTimeoutMs, probe.tls);
+                resetConnection(sockfd);
+                return probe;
+            }
+
+            // Now, set up select to wait for data to be readable
+            fd_set rfds;
+            FD_ZERO(&rfds);
+            FD_SET(sockfd, &rfds);
+            tv.tv_sec = settings.bannerTimeoutMs / 1000;
+            tv.tv_usec = (settings.bannerTimeoutMs % 1000) * 1000;
+
+            result = select(sockfd + 1, &rfds, NULL, NULL, &tv);
+            if (result > 0 && FD_ISSET(sockfd, &rfds)) {
+                // Data is available to read
+                char buffer[1024];
+                ssize_t bytes = recv(sockfd, buffer, sizeof(buffer) - 1, 0);
+                if (bytes > 0) {
+                    buffer[bytes] = '\0';
+                    probe.banner = buffer;
+                }
+            }
+        } else if (error == ECONNREFUSED) {
+            probe.status = PROBE_CLOSED;
+        }
+    }
+
+    close(sockfd);
+    return probe;
+}
+
+void worker(const std::string& ip) {
+    while (true) {
+        int port;
+        uint64_t ticket;
+
+        // Acquire lock and check for available tasks
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            cv.wait(lock, [] { return !port_queue.empty() || done; });
+
+            if (port_queue.empty()) {
+                if (done) break;
+                else continue;
+            }
+
+            port = port_queue.front();
+            port_queue.pop();
+            ticket = scan_clock->dequeued();
+        }
+
+        // Wait for the rate limit, then scan the port outside the lock
+        scan_clock->waitForSlot(ticket);
+        ProbeResult result = scanPort(ip, port);
+        scan_clock->finished(ticket, result.durationUs);
+    }
+}
+
+ProbeResult scanPort(const std::string& ip, int port) {
+    ProbeResult result = probe_backend->probe(ip, port, scan_settings);
+    if (result.status == PROBE_OPEN) {
+        open_port_handler(ip, port, result);
+    }
+    return result;
+}
+
+void scanPortsOnIP(const std::string& ip, int startPort, int endPort, int numThreads) {
+    // Populate the task queue and set 'done' to true
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        for (int port = startPort; port <= endPort; ++port) {
+            port_queue.push(port);
+        }
+        done = true;
+    }
+    scan_clock->begin(numThreads, scan_settings.maxProbesPerSec);
+
+    // Notify workers that tasks are available
+    cv.notify_all();
+
+    // Create worker threads
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(worker, ip);
+    }
+
+    // Join threads
+    for (auto& th : threads) {
+        th.join();
+    }
+}
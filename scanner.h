@@ -0,0 +1,110 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+/*
+
+Scan engine
+
+	scanPortsOnIP() fills a shared port queue and starts worker threads; each worker
+	pops ports and calls scanPort(). The network itself sits behind ProbeBackend, so
+	the same scheduler can drive real sockets (SocketBackend) or a simulated network
+	(see sim_network.h). Open ports are passed to the OpenPortHandler.
+
+	Time sits behind ScanClock. Workers take a ticket from the clock as they dequeue
+	a port, wait for the ticket's start slot under the rate limit, and report how long
+	the probe took. RealClock sleeps on the steady clock; VirtualClock replays the
+	same calls in virtual time, so scheduler, timeout and rate-limit changes show up
+	in simulated runs exactly as the workers made them.
+
+ */
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "tls_probe.h"
+
+enum ProbeStatus { PROBE_OPEN, PROBE_CLOSED, PROBE_FILTERED };
+
+struct ProbeResult {
+    ProbeStatus status;
+    std::string banner;
+    TlsCertInfo tls;        // Filled in for open TLS ports (see isTlsPort())
+    uint32_t durationUs;    // Time the probe took, modelled time for simulated backends
+};
+
+// Scheduler settings shared by every backend
+struct ScanSettings {
+    int connectTimeoutMs;
+    int bannerTimeoutMs;        // Also bounds the TLS handshake
+    double maxProbesPerSec;     // Probe starts per second across all workers, 0 for no limit
+};
+
+// 1000 ms timeouts, no rate limit
+ScanSettings defaultScanSettings();
+
+// Connects to one port and grabs a banner if the service sends one
+class ProbeBackend {
+public:
+    virtual ~ProbeBackend() {}
+    virtual ProbeResult probe(const std::string& ip, int port, const ScanSettings& settings) = 0;
+};
+
+// Non-blocking connect() and recv(), each bounded by select(). On TLS ports the
+// banner read is replaced by a TlsProbe handshake, after which the connection is reset.
+class SocketBackend : public ProbeBackend {
+public:
+    ProbeResult probe(const std::string& ip, int port, const ScanSettings& settings);
+
+private:
+    ProbeResult probeSocket(const std::string& ip, int port, const ScanSettings& settings);
+    void readCertificate(int sockfd, int timeoutMs, TlsCertInfo& tls);
+};
+
+// Time source for worker(). begin() runs before the workers start, dequeued() under
+// the queue lock in dequeue order; the ticket it returns is passed to waitForSlot()
+// before the probe and to finished() after it.
+class ScanClock {
+public:
+    virtual ~ScanClock() {}
+    virtual void begin(int workers, double maxProbesPerSec) = 0;
+    virtual uint64_t dequeued() = 0;
+    virtual void waitForSlot(uint64_t ticket) = 0;
+    virtual void finished(uint64_t ticket, uint32_t durationUs) = 0;
+};
+
+// Wall-clock pacing: tickets are start times on the steady clock, spaced by the rate limit
+class RealClock : public ScanClock {
+public:
+    RealClock();
+    void begin(int workers, double maxProbesPerSec);
+    uint64_t dequeued();
+    void waitForSlot(uint64_t ticket);
+    void finished(uint64_t ticket, uint32_t durationUs);
+
+private:
+    uint64_t intervalNs_;
+    uint64_t nextStartNs_;
+};
+
+// Close with an RST instead of a FIN handshake
+void resetConnection(int sockfd);
+
+typedef void (*OpenPortHandler)(const std::string& ip, int port, const ProbeResult& result);
+
+extern std::mutex cout_mutex;
+
+// Default handler: one "Port N is open on IP" line under cout_mutex
+void printOpenPort(const std::string& ip, int port, const ProbeResult& result);
+
+// These default to real sockets, printOpenPort(), the steady clock and defaultScanSettings()
+void setProbeBackend(ProbeBackend* backend);
+void setOpenPortHandler(OpenPortHandler handler);
+void setScanClock(ScanClock* clock);
+void setScanSettings(const ScanSettings& settings);
+const ScanSettings& scanSettings();
+
+ProbeResult scanPort(const std::string& ip, int port);
+void worker(const std::string& ip);
+void scanPortsOnIP(const std::string& ip, int startPort, int endPort, int numThreads);
+
+#endif
@@ -0,0 +1,190 @@
+#include "sim_network.h"
+
+#include <algorithm>
+#include <cmath>
+#include <arpa/inet.h>
+
+// splitmix64 finalizer: a cheap, well-mixed hash for deriving per-probe randomness
+static uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Uniform double in [0, 1) for draw number `stream` of a given key
+static double uniform(uint64_t key, uint64_t stream) {
+    return static_cast<double>(mix64(key ^ (stream * 0xd1b54a32d192ed03ULL)) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Standard normal via Box-Muller
+static double normal(uint64_t key, uint64_t stream) {
+    double u1 = 1.0 - uniform(key, stream);
+    double u2 = uniform(key, stream + 1);
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+}
+
+static uint32_t parseHost(const std::string& ip) {
+    in_addr addr;
+    return inet_pton(AF_INET, ip.c_str(), &addr) == 1 ? ntohl(addr.s_addr) : 0;
+}
+
+SimHostProfile defaultSimHostProfile() {
+    SimHostProfile profile;
+    profile.rttMedianMs = 20.0;
+    profile.rttSigma = 0.25;
+    profile.openRatio = 0.01;
+    profile.closedRatio = 0.60;
+    profile.lossRatio = 0.01;
+    profile.bannerRatio = 0.4;
+    profile.bannerDelayMs = 50.0;
+    return profile;
+}
+
+SimulatedNetwork::SimulatedNetwork(uint64_t seed, const SimHostProfile& defaults)
+    : seed_(mix64(seed)),
+      defaults_(defaults),
+      probes_(0), open_(0), closed_(0), filtered_(0), lost_(0), virtualUs_(0) {}
+
+void SimulatedNetwork::setHostProfile(const std::string& ip, const SimHostProfile& profile) {
+    profiles_[parseHost(ip)] = profile;
+}
+
+SimHostProfile SimulatedNetwork::hostProfile(uint32_t host) const {
+    std::unordered_map<uint32_t, SimHostProfile>::const_iterator it = profiles_.find(host);
+    if (it != profiles_.end()) return it->second;
+
+    // Spread host medians log-uniformly between 1/4x and 4x of the default
+    SimHostProfile profile = defaults_;
+    profile.rttMedianMs *= std::exp((uniform(seed_ ^ host, 0) * 2.0 - 1.0) * std::log(4.0));
+    return profile;
+}
+
+SimProbe SimulatedNetwork::simulate(const std::string& ip, int port, const ScanSettings& settings) const {
+    const uint32_t connectTimeoutUs = static_cast<uint32_t>(settings.connectTimeoutMs) * 1000;
+    const uint32_t bannerTimeoutUs = static_cast<uint32_t>(settings.bannerTimeoutMs) * 1000;
+    const uint32_t host = parseHost(ip);
+    const SimHostProfile profile = hostProfile(host);
+    const uint64_t key = mix64(seed_ ^ (static_cast<uint64_t>(host) << 16) ^ static_cast<uint64_t>(port));
+
+    SimProbe probe;
+    probe.lost = uniform(key, 1) < profile.lossRatio;
+    probe.banner = false;
+
+    double draw = uniform(key, 2);
+    if (draw < profile.openRatio) {
+        probe.status = PROBE_OPEN;
+    } else if (draw < profile.openRatio + profile.closedRatio) {
+        probe.status = PROBE_CLOSED;
+    } else {
+        probe.status = PROBE_FILTERED;
+    }
+
+    double rttUs = profile.rttMedianMs * 1000.0 * std::exp(profile.rttSigma * normal(key, 3));
+
+    // No answer within the connect timeout looks the same as a filtered port
+    if (probe.status == PROBE_FILTERED || probe.lost || rttUs >= connectTimeoutUs) {
+        probe.status = PROBE_FILTERED;
+        probe.durationUs = connectTimeoutUs;
+        return probe;
+    }
+
+    if (probe.status == PROBE_CLOSED) {
+        probe.durationUs = static_cast<uint32_t>(rttUs);
+        return probe;
+    }
+
+    // Open: wait for the service to speak first, up to the banner timeout
+    double bannerUs = -std::log(1.0 - uniform(key, 5)) * profile.bannerDelayMs * 1000.0;
+    probe.banner = uniform(key, 6) < profile.bannerRatio && bannerUs < bannerTimeoutUs;
+    probe.durationUs = static_cast<uint32_t>(rttUs + (probe.banner ? bannerUs : bannerTimeoutUs));
+    return probe;
+}
+
+ProbeResult SimulatedNetwork::probe(const std::string& ip, int port, const ScanSettings& settings) {
+    SimProbe sim = simulate(ip, port, settings);
+
+    probes_.fetch_add(1, std::memory_order_relaxed);
+    virtualUs_.fetch_add(sim.durationUs, std::memory_order_relaxed);
+    if (sim.lost) lost_.fetch_add(1, std::memory_order_relaxed);
+
+    ProbeResult result;
+    result.status = sim.status;
+    result.durationUs = sim.durationUs;
+    switch (sim.status) {
+        case PROBE_OPEN:
+            open_.fetch_add(1, std::memory_order_relaxed);
+            if (sim.banner) result.banner = "SIM-" + std::to_string(port);
+            break;
+        case PROBE_CLOSED:
+            closed_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case PROBE_FILTERED:
+            filtered_.fetch_add(1, std::memory_order_relaxed);
+            break;
+    }
+    return result;
+}
+
+SimStats SimulatedNetwork::stats() const {
+    SimStats stats;
+    stats.probes = probes_.load();
+    stats.open = open_.load();
+    stats.closed = closed_.load();
+    stats.filtered = filtered_.load();
+    stats.lost = lost_.load();
+    stats.virtualUs = virtualUs_.load();
+    return stats;
+}
+
+VirtualClock::VirtualClock() : issued_(0), replayed_(0), intervalNs_(0), nextStartNs_(0), endNs_(0) {}
+
+void VirtualClock::begin(int workers, double maxProbesPerSec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    freeAt_ = std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>>();
+    for (int i = 0; i < std::max(workers, 1); ++i) freeAt_.push(endNs_);
+    pending_.clear();
+    issued_ = 0;
+    replayed_ = 0;
+    intervalNs_ = maxProbesPerSec > 0 ? static_cast<uint64_t>(1e9 / maxProbesPerSec) : 0;
+    nextStartNs_ = endNs_;
+}
+
+// Runs under the scheduler's queue lock, so tickets follow dequeue order
+uint64_t VirtualClock::dequeued() {
+    return issued_++;
+}
+
+void VirtualClock::waitForSlot(uint64_t) {}
+
+// Probes finish in any order on the real threads; replay them strictly by ticket
+void VirtualClock::finished(uint64_t ticket, uint32_t durationUs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ticket != replayed_) {
+        pending_[ticket] = durationUs;
+        return;
+    }
+
+    schedule(durationUs);
+    for (auto it = pending_.find(replayed_); it != pending_.end(); it = pending_.find(replayed_)) {
+        schedule(it->second);
+        pending_.erase(it);
+    }
+}
+
+uint64_t VirtualClock::now() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return endNs_;
+}
+
+// Start the next probe on the first free worker, no earlier than the rate limit allows
+void VirtualClock::schedule(uint32_t durationUs) {
+    uint64_t start = std::max(freeAt_.top(), nextStartNs_);
+    freeAt_.pop();
+
+    uint64_t finish = start + static_cast<uint64_t>(durationUs) * 1000;
+    freeAt_.push(finish);
+    nextStartNs_ = start + intervalNs_;
+    endNs_ = std::max(endNs_, finish);
+    replayed_++;
+}
@@ -0,0 +1,120 @@
+#ifndef SIM_NETWORK_H
+#define SIM_NETWORK_H
+
+/*
+
+Simulated network
+
+	A ProbeBackend that answers instantly from a seeded model instead of touching
+	sockets, so the scheduler can be run against millions of targets and the same
+	seed always produces the same open/closed/filtered answers and banners.
+
+	Every probe outcome is a pure function of (seed, host, port): status from the
+	host's open/closed ratios (the rest is filtered), packet loss, a log-normal RTT
+	around the host's median and an exponential banner delay. Lost and filtered
+	probes cost the full connect timeout, open ports without a timely banner cost
+	the banner timeout on top of the RTT, just like SocketBackend. Both timeouts come
+	from the scheduler's ScanSettings.
+
+	VirtualClock is the ScanClock for simulated runs. It takes the probes in the order
+	worker() dequeued them and starts each on the first of N virtual workers to come
+	free, no earlier than the rate limit allows, to give the wall time the scan would
+	have taken on the modelled network.
+
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "scanner.h"
+
+struct SimHostProfile {
+    double rttMedianMs;     // Median round trip
+    double rttSigma;        // Log-normal spread of the round trip
+    double openRatio;
+    double closedRatio;     // Whatever is neither open nor closed is filtered
+    double lossRatio;       // SYN or SYN-ACK dropped, seen as a timeout
+    double bannerRatio;     // Open services that speak first
+    double bannerDelayMs;   // Mean delay before the banner arrives
+};
+
+// Defaults for hosts without an explicit profile. Each host's median RTT is
+// spread up to 4x either side of rttMedianMs, derived from the seed.
+SimHostProfile defaultSimHostProfile();
+
+struct SimProbe {
+    ProbeStatus status;
+    bool lost;
+    bool banner;
+    uint32_t durationUs;
+};
+
+struct SimStats {
+    uint64_t probes;
+    uint64_t open;
+    uint64_t closed;
+    uint64_t filtered;
+    uint64_t lost;
+    uint64_t virtualUs;     // Sum of all probe durations
+};
+
+class SimulatedNetwork : public ProbeBackend {
+public:
+    SimulatedNetwork(uint64_t seed, const SimHostProfile& defaults);
+
+    // Must be called before scanning starts
+    void setHostProfile(const std::string& ip, const SimHostProfile& profile);
+
+    SimProbe simulate(const std::string& ip, int port, const ScanSettings& settings) const;
+    ProbeResult probe(const std::string& ip, int port, const ScanSettings& settings);
+
+    SimStats stats() const;
+
+private:
+    SimHostProfile hostProfile(uint32_t host) const;
+
+    uint64_t seed_;
+    SimHostProfile defaults_;
+    std::unordered_map<uint32_t, SimHostProfile> profiles_;
+
+    std::atomic<uint64_t> probes_;
+    std::atomic<uint64_t> open_;
+    std::atomic<uint64_t> closed_;
+    std::atomic<uint64_t> filtered_;
+    std::atomic<uint64_t> lost_;
+    std::atomic<uint64_t> virtualUs_;
+};
+
+// Virtual time for N workers. Successive begin() calls continue from the end of the
+// previous scan, as scanPortsOnIP() joins its workers before returning.
+class VirtualClock : public ScanClock {
+public:
+    VirtualClock();
+
+    void begin(int workers, double maxProbesPerSec);
+    uint64_t dequeued();
+    void waitForSlot(uint64_t ticket);
+    void finished(uint64_t ticket, uint32_t durationUs);
+
+    // Time at which the last replayed probe finishes, in ns
+    uint64_t now();
+
+private:
+    void schedule(uint32_t durationUs);
+
+    std::mutex mutex_;
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> freeAt_;
+    std::unordered_map<uint64_t, uint32_t> pending_;    // Finished ahead of an earlier ticket
+    uint64_t issued_;
+    uint64_t replayed_;
+    uint64_t intervalNs_;
+    uint64_t nextStartNs_;
+    uint64_t endNs_;
+};
+
+#endif
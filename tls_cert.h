@@ -0,0 +1,24 @@
+#ifndef TLS_CERT_H
+#define TLS_CERT_H
+
+/*
+
+TLS certificate details
+
+	What TlsProbe (tls_probe.h) learns about an open TLS port. Kept apart from the
+	probe so the database layer can store it without pulling in the handshake code.
+
+ */
+
+#include <cstdint>
+#include <string>
+
+struct TlsCertInfo {
+    std::string version;    // Negotiated protocol, e.g. "TLSv1.2"; empty if no ServerHello
+    std::string subject;    // "CN=example.com, O=Example"
+    std::string issuer;
+    std::string san;        // "DNS:example.com, IP:192.0.2.1"
+    int64_t notAfter = 0;   // Expiry as epoch seconds, 0 if unknown
+};
+
+#endif
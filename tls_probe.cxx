@@ -0,0 +1,371 @@
+#include "tls_probe.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <arpa/inet.h>
+
+// Upper bound on the server flight we are willing to buffer (certificate chains are a few KB)
+const size_t MAX_FLIGHT_BYTES = 256 * 1024;
+
+static void put8(std::string& out, unsigned v) {
+    out.push_back(static_cast<char>(v & 0xff));
+}
+
+static void put16(std::string& out, unsigned v) {
+    put8(out, v >> 8);
+    put8(out, v);
+}
+
+static void put24(std::string& out, unsigned v) {
+    put8(out, v >> 16);
+    put16(out, v);
+}
+
+static unsigned get16(const unsigned char* p) {
+    return (static_cast<unsigned>(p[0]) << 8) | p[1];
+}
+
+static unsigned get24(const unsigned char* p) {
+    return (static_cast<unsigned>(p[0]) << 16) | get16(p + 1);
+}
+
+static std::string versionName(unsigned version) {
+    switch (version) {
+        case 0x0300: return "SSLv3";
+        case 0x0301: return "TLSv1.0";
+        case 0x0302: return "TLSv1.1";
+        case 0x0303: return "TLSv1.2";
+        case 0x0304: return "TLSv1.3";
+    }
+    return "unknown";
+}
+
+// TLS 1.2 ClientHello with the cipher suites and extensions common servers expect
+static std::string buildClientHello() {
+    static const unsigned cipherSuites[] = {
+        0xc02b, 0xc02f, 0xc02c, 0xc030, 0xcca9, 0xcca8,   // ECDHE with AES-GCM / ChaCha20
+        0xc009, 0xc013, 0xc00a, 0xc014,                   // ECDHE with AES-CBC
+        0x009c, 0x009d, 0x002f, 0x0035,                   // RSA key exchange
+        0x00ff,                                           // Renegotiation SCSV
+    };
+    static const unsigned groups[] = {0x001d, 0x0017, 0x0018, 0x0019};
+    static const unsigned signatureAlgorithms[] = {
+        0x0403, 0x0503, 0x0603, 0x0804, 0x0805, 0x0806, 0x0401, 0x0501, 0x0601, 0x0201, 0x0203,
+    };
+
+    std::string extensions;
+    put16(extensions, 0x000a);    // supported_groups
+    put16(extensions, 2 + sizeof(groups) / sizeof(groups[0]) * 2);
+    put16(extensions, sizeof(groups) / sizeof(groups[0]) * 2);
+    for (unsigned group : groups) put16(extensions, group);
+
+    put16(extensions, 0x000b);    // ec_point_formats: uncompressed
+    put16(extensions, 2);
+    put8(extensions, 1);
+    put8(extensions, 0);
+
+    put16(extensions, 0x000d);    // signature_algorithms
+    put16(extensions, 2 + sizeof(signatureAlgorithms) / sizeof(signatureAlgorithms[0]) * 2);
+    put16(extensions, sizeof(signatureAlgorithms) / sizeof(signatureAlgorithms[0]) * 2);
+    for (unsigned algorithm : signatureAlgorithms) put16(extensions, algorithm);
+
+    put16(extensions, 0x0017);    // extended_master_secret
+    put16(extensions, 0);
+
+    std::string body;
+    put16(body, 0x0303);
+    std::random_device random;
+    for (int i = 0; i < 32; i += 4) {
+        unsigned value = random();
+        put16(body, value >> 16);
+        put16(body, value);
+    }
+    put8(body, 0);                // No session id
+    put16(body, sizeof(cipherSuites) / sizeof(cipherSuites[0]) * 2);
+    for (unsigned suite : cipherSuites) put16(body, suite);
+    put8(body, 1);                // Null compression only
+    put8(body, 0);
+    put16(body, extensions.size());
+    body += extensions;
+
+    std::string handshake;
+    put8(handshake, 0x01);        // ClientHello
+    put24(handshake, body.size());
+    handshake += body;
+
+    std::string record;
+    put8(record, 0x16);           // Handshake record
+    put16(record, 0x0301);
+    put16(record, handshake.size());
+    return record + handshake;
+}
+
+TlsProbe::TlsProbe() : state_(TLS_WANT_READ), clientHello_(buildClientHello()) {}
+
+TlsProbeState TlsProbe::onData(const char* data, size_t len) {
+    if (state_ != TLS_WANT_READ) return state_;
+
+    records_.append(data, len);
+    if (records_.size() + handshake_.size() > MAX_FLIGHT_BYTES) return state_ = TLS_FAILED;
+
+    // Unwrap complete records into the handshake buffer
+    size_t offset = 0;
+    while (records_.size() - offset >= 5) {
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(records_.data() + offset);
+        const unsigned type = header[0];
+        const size_t length = get16(header + 3);
+
+        // Anything that is not a TLS record (a plaintext banner, for instance) ends the probe
+        if (header[1] != 0x03 || type < 0x14 || type > 0x17) return state_ = TLS_FAILED;
+        if (records_.size() - offset < 5 + length) break;
+
+        if (type == 0x15) return state_ = TLS_FAILED;    // Alert
+        if (type != 0x16) {
+            // ChangeCipherSpec or encrypted data: nothing more we can read in the clear
+            return state_ = info_.version.empty() ? TLS_FAILED : TLS_DONE;
+        }
+
+        handshake_.append(records_, offset + 5, length);
+        offset += 5 + length;
+    }
+    records_.erase(0, offset);
+
+    if (parseHandshake()) state_ = TLS_DONE;
+    return state_;
+}
+
+// Consume complete handshake messages; returns true once there is nothing left to learn
+bool TlsProbe::parseHandshake() {
+    size_t offset = 0;
+    bool finished = false;
+
+    while (!finished && handshake_.size() - offset >= 4) {
+        const unsigned char* message = reinterpret_cast<const unsigned char*>(handshake_.data() + offset);
+        const size_t length = get24(message + 1);
+        if (handshake_.size() - offset < 4 + length) break;
+
+        const unsigned char* body = message + 4;
+        switch (message[0]) {
+            case 0x02: {    // ServerHello
+                if (length < 38) {
+                    state_ = TLS_FAILED;
+                    return false;
+                }
+                unsigned version = get16(body);
+
+                // A supported_versions extension overrides the legacy version field
+                size_t pos = 34;
+                pos += 1 + body[pos];           // Session id
+                pos += 3;                       // Cipher suite, compression
+                if (pos + 2 <= length) {
+                    size_t end = std::min(length, pos + 2 + get16(body + pos));
+                    pos += 2;
+                    while (pos + 4 <= end) {
+                        unsigned type = get16(body + pos);
+                        size_t size = get16(body + pos + 2);
+                        if (type == 0x002b && size == 2 && pos + 6 <= end) version = get16(body + pos + 4);
+                        pos += 4 + size;
+                    }
+                }
+
+                info_.version = versionName(version);
+                finished = version == 0x0304;   // The certificate would be encrypted
+                break;
+            }
+            case 0x0b:      // Certificate: only the leaf is of interest
+                if (length >= 6) {
+                    size_t certLength = get24(body + 3);
+                    if (6 + certLength <= length) parseCertificate(body + 6, certLength, info_);
+                }
+                finished = true;
+                break;
+            case 0x0e:      // ServerHelloDone without a certificate
+                finished = true;
+                break;
+            default:
+                break;
+        }
+
+        offset += 4 + length;
+    }
+
+    handshake_.erase(0, offset);
+    return finished;
+}
+
+bool isTlsPort(int port) {
+    switch (port) {
+        case 443: case 465: case 636: case 853: case 989: case 990: case 992:
+        case 993: case 994: case 995: case 5061: case 8443: case 9443:
+            return true;
+    }
+    return false;
+}
+
+// Minimal DER reader: just enough to walk the fields of an X.509 certificate
+struct DerReader {
+    const unsigned char* p;
+    size_t len;
+};
+
+static bool readTlv(DerReader& reader, unsigned char& tag, DerReader& value) {
+    if (reader.len < 2) return false;
+
+    tag = reader.p[0];
+    size_t length = reader.p[1];
+    size_t header = 2;
+    if (length & 0x80) {
+        size_t bytes = length & 0x7f;
+        if (bytes == 0 || bytes > 4 || reader.len < 2 + bytes) return false;
+        length = 0;
+        for (size_t i = 0; i < bytes; ++i) length = (length << 8) | reader.p[2 + i];
+        header += bytes;
+    }
+    if (reader.len - header < length) return false;
+
+    value.p = reader.p + header;
+    value.len = length;
+    reader.p += header + length;
+    reader.len -= header + length;
+    return true;
+}
+
+static bool expectTlv(DerReader& reader, unsigned char expected, DerReader& value) {
+    unsigned char tag;
+    return readTlv(reader, tag, value) && tag == expected;
+}
+
+static std::string derString(unsigned char tag, const DerReader& value) {
+    std::string text;
+    if (tag == 0x1e) {
+        // BMPString: keep the ASCII range of the UCS-2 code units
+        for (size_t i = 0; i + 1 < value.len; i += 2) {
+            if (value.p[i] == 0) text.push_back(static_cast<char>(value.p[i + 1]));
+        }
+    } else {
+        text.assign(reinterpret_cast<const char*>(value.p), value.len);
+    }
+    return text;
+}
+
+// Name ::= SEQUENCE OF SET OF SEQUENCE { type OID, value ANY }
+static std::string parseName(DerReader name) {
+    static const struct {
+        unsigned char oid;      // Last byte of 2.5.4.x
+        const char* label;
+    } attributes[] = {
+        {3, "CN"}, {6, "C"}, {7, "L"}, {8, "ST"}, {10, "O"}, {11, "OU"},
+    };
+
+    std::string text;
+    DerReader set, attribute, oid, value;
+    unsigned char tag;
+    while (expectTlv(name, 0x31, set)) {
+        while (expectTlv(set, 0x30, attribute)) {
+            if (!expectTlv(attribute, 0x06, oid) || !readTlv(attribute, tag, value)) continue;
+            if (oid.len != 3 || oid.p[0] != 0x55 || oid.p[1] != 0x04) continue;
+
+            for (size_t i = 0; i < sizeof(attributes) / sizeof(attributes[0]); ++i) {
+                if (attributes[i].oid != oid.p[2]) continue;
+                if (!text.empty()) text += ", ";
+                text += std::string(attributes[i].label) + "=" + derString(tag, value);
+            }
+        }
+    }
+    return text;
+}
+
+// UTCTime (YYMMDDHHMMSSZ) or GeneralizedTime (YYYYMMDDHHMMSSZ) to epoch seconds
+static int64_t parseTime(unsigned char tag, const DerReader& value) {
+    std::string text(reinterpret_cast<const char*>(value.p), value.len);
+    size_t yearDigits = tag == 0x17 ? 2 : 4;
+    if (text.size() < yearDigits + 10) return 0;
+    for (size_t i = 0; i < yearDigits + 10; ++i) {
+        if (text[i] < '0' || text[i] > '9') return 0;
+    }
+
+    std::tm tm;
+    std::memset(&tm, 0, sizeof(tm));
+    int year = std::atoi(text.substr(0, yearDigits).c_str());
+    if (tag == 0x17) year += year >= 50 ? 1900 : 2000;
+    tm.tm_year = year - 1900;
+    tm.tm_mon = std::atoi(text.substr(yearDigits, 2).c_str()) - 1;
+    tm.tm_mday = std::atoi(text.substr(yearDigits + 2, 2).c_str());
+    tm.tm_hour = std::atoi(text.substr(yearDigits + 4, 2).c_str());
+    tm.tm_min = std::atoi(text.substr(yearDigits + 6, 2).c_str());
+    tm.tm_sec = std::atoi(text.substr(yearDigits + 8, 2).c_str());
+    return static_cast<int64_t>(timegm(&tm));
+}
+
+// GeneralNames from a subjectAltName extension value
+static std::string parseSubjectAltName(DerReader extension) {
+    std::string text;
+    DerReader names, name;
+    unsigned char tag;
+    if (!expectTlv(extension, 0x30, names)) return text;
+
+    while (readTlv(names, tag, name)) {
+        std::string entry;
+        if (tag == 0x82) {
+            entry = "DNS:" + std::string(reinterpret_cast<const char*>(name.p), name.len);
+        } else if (tag == 0x87 && (name.len == 4 || name.len == 16)) {
+            char address[INET6_ADDRSTRLEN];
+            if (inet_ntop(name.len == 4 ? AF_INET : AF_INET6, name.p, address, sizeof(address))) {
+                entry = std::string("IP:") + address;
+            }
+        }
+        if (entry.empty()) continue;
+        if (!text.empty()) text += ", ";
+        text += entry;
+    }
+    return text;
+}
+
+bool parseCertificate(const unsigned char* der, size_t len, TlsCertInfo& info) {
+    DerReader reader = {der, len};
+    DerReader certificate, tbs, field, validity;
+    unsigned char tag;
+
+    if (!expectTlv(reader, 0x30, certificate) || !expectTlv(certificate, 0x30, tbs)) return false;
+
+    // [0] version is optional
+    if (tbs.len > 0 && tbs.p[0] == 0xa0 && !readTlv(tbs, tag, field)) return false;
+    if (!expectTlv(tbs, 0x02, field)) return false;      // serialNumber
+    if (!expectTlv(tbs, 0x30, field)) return false;      // signature algorithm
+
+    if (!expectTlv(tbs, 0x30, field)) return false;
+    info.issuer = parseName(field);
+
+    if (!expectTlv(tbs, 0x30, validity)) return false;
+    if (!readTlv(validity, tag, field)) return false;    // notBefore
+    if (!readTlv(validity, tag, field)) return false;
+    info.notAfter = parseTime(tag, field);
+
+    if (!expectTlv(tbs, 0x30, field)) return false;
+    info.subject = parseName(field);
+
+    if (!expectTlv(tbs, 0x30, field)) return false;      // subjectPublicKeyInfo
+
+    // Skip the optional unique ids, then look for subjectAltName in [3] extensions
+    while (readTlv(tbs, tag, field)) {
+        if (tag != 0xa3) continue;
+
+        DerReader extensions, extension, oid, value;
+        if (!expectTlv(field, 0x30, extensions)) break;
+        while (expectTlv(extensions, 0x30, extension)) {
+            if (!expectTlv(extension, 0x06, oid)) continue;
+            if (!readTlv(extension, tag, value)) continue;
+            if (tag == 0x01 && !readTlv(extension, tag, value)) continue;    // critical flag
+            if (tag != 0x04) continue;
+
+            if (oid.len == 3 && oid.p[0] == 0x55 && oid.p[1] == 0x1d && oid.p[2] == 0x11) {
+                info.san = parseSubjectAltName(value);
+            }
+        }
+    }
+
+    return true;
+}
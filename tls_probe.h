@@ -0,0 +1,60 @@
+#ifndef TLS_PROBE_H
+#define TLS_PROBE_H
+
+/*
+
+TLS certificate probe
+
+	A passive banner read on a TLS port just times out, because the client has to
+	speak first. TlsProbe sends a TLS 1.2 ClientHello and parses just enough of the
+	server's first flight (ServerHello, Certificate) to pull out the negotiated
+	version and the leaf certificate's subject, issuer, SAN and expiry. The caller
+	then resets the connection; no key exchange ever happens.
+
+	TLS 1.3 is not offered on purpose: its Certificate message is encrypted, while
+	a TLS 1.2 server sends it in the clear.
+
+	TlsProbe does no I/O. It is a resumable state machine: the caller sends
+	clientHello() once the connection is up and feeds whatever bytes arrive to
+	onData() until it stops returning TLS_WANT_READ, so it can be driven by any
+	non-blocking event loop without tying up a thread per handshake.
+
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "tls_cert.h"
+
+enum TlsProbeState { TLS_WANT_READ, TLS_DONE, TLS_FAILED };
+
+class TlsProbe {
+public:
+    TlsProbe();
+
+    // Bytes to send as soon as the TCP connection is established
+    const std::string& clientHello() const { return clientHello_; }
+
+    // Feed bytes received from the server
+    TlsProbeState onData(const char* data, size_t len);
+
+    TlsProbeState state() const { return state_; }
+    const TlsCertInfo& info() const { return info_; }
+
+private:
+    bool parseHandshake();
+
+    TlsProbeState state_;
+    std::string clientHello_;
+    std::string records_;     // Unparsed record-layer bytes
+    std::string handshake_;   // Reassembled handshake messages
+    TlsCertInfo info_;
+};
+
+// Ports where services expect the client to start a TLS handshake
+bool isTlsPort(int port);
+
+// Extract subject, issuer, SAN and expiry from a DER-encoded X.509 certificate
+bool parseCertificate(const unsigned char* der, size_t len, TlsCertInfo& info);
+
+#endif
@@ -0,0 +1,101 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <sqlite3.h>
+#include "scan_db.h"
+
+struct TrendPoint {
+    long long bucket_start;
+    long long open_count;
+};
+
+// Open-port counts per time bucket, read from scan_rollups only
+int run_trend_report(const std::string& granularity, const std::string& host, int port, int buckets) {
+    // Creates scan_rollups, or fills it from an older database, before reading it
+    ScanDbConfig config = scan_db_config();
+    config.retention_days = 0;
+    if (!init_scan_db(config)) return 1;
+
+    sqlite3* db = open_scan_db(config.path);
+    if (!db) return 1;
+
+    const char* query =
+        "SELECT bucket_start, SUM(open_count) FROM scan_rollups "
+        "WHERE granularity = ?1 AND (?2 IS NULL OR ip_address = ?2) AND (?3 IS NULL OR port = ?3) "
+        "GROUP BY bucket_start ORDER BY bucket_start DESC LIMIT ?4;";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) != SQLITE_OK) {
+        std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return 1;
+    }
+    sqlite3_bind_text(stmt, 1, granularity.c_str(), -1, SQLITE_TRANSIENT);
+    if (!host.empty()) sqlite3_bind_text(stmt, 2, host.c_str(), -1, SQLITE_TRANSIENT);
+    if (port > 0) sqlite3_bind_int(stmt, 3, port);
+    sqlite3_bind_int(stmt, 4, buckets);
+
+    std::vector<TrendPoint> points;
+    long long peak = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        TrendPoint point;
+        point.bucket_start = sqlite3_column_int64(stmt, 0);
+        point.open_count = sqlite3_column_int64(stmt, 1);
+        if (point.open_count > peak) peak = point.open_count;
+        points.push_back(point);
+    }
+    if (rc != SQLITE_DONE) std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    if (rc != SQLITE_DONE) return 1;
+
+    std::cout << "Open Ports Per " << granularity;
+    if (!host.empty()) std::cout << " | Host: " << host;
+    if (port > 0) std::cout << " | Port: " << port;
+    std::cout << "\n";
+
+    // Oldest bucket first, with a bar scaled to the busiest bucket. Buckets start at UTC
+    // boundaries (weeks on Monday 00:00 UTC), so they are labelled in UTC.
+    const char* format = granularity == "hour" ? "%Y-%m-%d %H:00 UTC" : "%Y-%m-%d UTC";
+    for (size_t i = points.size(); i > 0; --i) {
+        std::time_t start = static_cast<std::time_t>(points[i - 1].bucket_start);
+        std::tm utc;
+        gmtime_r(&start, &utc);
+        char label[32];
+        std::strftime(label, sizeof(label), format, &utc);
+
+        int width = peak > 0 ? static_cast<int>(points[i - 1].open_count * 40 / peak) : 0;
+        std::cout << label << " | " << std::setw(8) << points[i - 1].open_count << " | "
+                  << std::string(width, '#') << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string granularity = "day";
+    std::string host;
+    int port = 0;
+    int buckets = 14;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "hour" || arg == "day" || arg == "week") {
+            granularity = arg;
+        } else if (arg == "--host" && i + 1 < argc) {
+            host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = std::atoi(argv[++i]);
+        } else if (arg == "--last" && i + 1 < argc) {
+            buckets = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [hour|day|week] [--host IP] [--port N] [--last N]" << std::endl;
+            return 1;
+        }
+    }
+
+    return run_trend_report(granularity, host, port, buckets);
+}